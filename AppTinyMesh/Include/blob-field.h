@@ -0,0 +1,71 @@
+// Skeletal blob field
+
+#pragma once
+
+#include "implicits.h"
+
+class BlobField : public AnalyticScalarField
+{
+public:
+  //! Skeletal primitive with compact support, a point or a segment.
+  struct Blob
+  {
+    Vector a, b; //!< End vertices of the skeleton, which are equal for a point.
+    double r;    //!< Radius of the support.
+    double w;    //!< Weight.
+    explicit Blob(const Vector&, double, double = 1.0);
+    explicit Blob(const Vector&, const Vector&, double, double = 1.0);
+  };
+protected:
+  //! Primitive prepared for evaluation.
+  struct Primitive
+  {
+    Vector a;     //!< First end vertex.
+    Vector ab;    //!< Axis of the segment, null for a point.
+    double il;    //!< Inverse of the squared length of the axis, 0 for a point.
+    double rr;    //!< Squared radius.
+    double irr;   //!< Inverse of the squared radius.
+    double w;     //!< Weight.
+  };
+protected:
+  std::vector<Primitive> primitives; //!< Primitives.
+  double threshold;                  //!< Threshold of the surface.
+
+  // Uniform grid
+  Box box;                  //!< Region covered by the supports of the primitives.
+  int nx, ny, nz;           //!< Number of cells along each axis.
+  Vector d;                 //!< Size of a cell.
+  std::vector<int> first;   //!< Index of the first primitive of every cell in the cell lists, with a final sentinel.
+  std::vector<int> cells;   //!< Primitives overlapping every cell, concatenated.
+  double k;                 //!< Lipschitz constant.
+public:
+  explicit BlobField(const std::vector<Blob>&, double = 0.5);
+
+  virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  int Primitives() const;
+  Box GetBox() const;
+protected:
+  int Cell(const Vector&) const;
+  static double Distance(const Primitive&, const Vector&, Vector&);
+};
+
+/*!
+\brief Return the number of primitives.
+*/
+inline int BlobField::Primitives() const
+{
+  return int(primitives.size());
+}
+
+/*!
+\brief Return the box enclosing the supports of the primitives, outside of which the field is the threshold.
+*/
+inline Box BlobField::GetBox() const
+{
+  return box;
+}
@@ -7,6 +7,8 @@
 
 #include "mathematics.h"
 
+class Ray;
+
 class Box
 {
 protected:
@@ -42,6 +44,10 @@ public:
   bool Inside(const Box&) const;
   bool Inside(const Vector&) const;
 
+  double Distance(const Vector&) const;
+
+  bool Intersect(const Ray&, double&, double&) const;
+
   double Volume() const;
   double Area() const;
 
@@ -153,6 +159,29 @@ inline bool Box::Inside(const Vector& p) const
   return ((a < p) && (b > p));
 }
 
+/*!
+\brief Compute the Euclidean distance between a point and the box.
+
+The distance is null if the point is inside the box.
+\param p Point.
+*/
+inline double Box::Distance(const Vector& p) const
+{
+  double r = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    if (p[i] < a[i])
+    {
+      r += (a[i] - p[i]) * (a[i] - p[i]);
+    }
+    else if (p[i] > b[i])
+    {
+      r += (p[i] - b[i]) * (p[i] - b[i]);
+    }
+  }
+  return sqrt(r);
+}
+
 /*!
 \brief Check if two boxes are (strictly) equal.
 \param a, b Boxes.
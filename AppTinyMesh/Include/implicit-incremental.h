@@ -0,0 +1,45 @@
+// Incremental polygonization
+
+#pragma once
+
+#include "scalar-grid.h"
+
+class IncrementalPolygonizer : public ScalarGrid
+{
+protected:
+  const AnalyticScalarField* source; //!< Polygonized field, not owned.
+  double epsilon;                    //!< Epsilon value for computing vertices on straddling edges.
+  std::unordered_map<long long, int> edges; //!< Vertex index of every straddling edge.
+  std::vector<long long> keys;       //!< Edge key of every vertex.
+  std::vector<long long> cells;      //!< Cell key of every triangle.
+  std::unordered_map<long long, std::vector<int> > triangles; //!< Triangles of every straddling cell.
+public:
+  explicit IncrementalPolygonizer(const AnalyticScalarField&, int, const Box&, const double& = 1e-4, int = 1);
+
+  void Polygonize(Mesh&);
+  void Update(Mesh&, const Box&, const Box&);
+protected:
+  void PolygonizeCells(Mesh&, const int*, const int*, const bool*, const bool*);
+  long long EdgeKey(int, int, int, int) const;
+  long long CellKey(int, int, int) const;
+  void MoveVertex(Mesh&, int, int);
+};
+
+/*!
+\brief Compute the key of the edge starting at a grid node along an axis.
+\param i,j,k Integer coordinates of the node.
+\param a Axis.
+*/
+inline long long IncrementalPolygonizer::EdgeKey(int i, int j, int k, int a) const
+{
+  return ((long long)(k * (long long)(ny) + j) * nx + i) * 3 + a;
+}
+
+/*!
+\brief Compute the key of a cell.
+\param i,j,k Integer coordinates of the lower corner of the cell.
+*/
+inline long long IncrementalPolygonizer::CellKey(int i, int j, int k) const
+{
+  return (long long)(k * (long long)(ny - 1) + j) * (nx - 1) + i;
+}
@@ -0,0 +1,381 @@
+// Static implicit fields
+
+#pragma once
+
+#include "implicits.h"
+
+/*!
+\brief Expression templates for implicit surfaces.
+
+Field functions are composed as types, for instance:
+\code
+using Field = Implicit::Blend<Implicit::Sphere, Implicit::Translate<Implicit::Torus> >;
+Field f(Implicit::Sphere(1.0), Implicit::Translate<Implicit::Torus>(Implicit::Torus(1.0, 0.25), Vector(1.0, 0.0, 0.0)), 0.5);
+
+Mesh mesh;
+AnalyticScalarField::Polygonize(f, 64, mesh, Box(2.5));
+\endcode
+The value and the gradient of the composed type are fully inlined, and
+AnalyticScalarField::Polygonize(const Field&, int, Mesh&, const Box&, const double&, RootFinder, int, Evaluations*) instantiates
+the marching cubes loop for that type, without any virtual call.
+
+All primitives are exact signed distance functions, and the gradients are analytic.
+*/
+namespace Implicit
+{
+  /*!
+  \brief Base class of all static field functions, using the curiously recurring template pattern.
+
+  Derived classes should implement Value(const Vector&) and Gradient(const Vector&), and may implement
+  ValueGradient(const Vector&, Vector&) to share the terms of the value and the gradient.
+  */
+  template<typename Derived>
+  class Expression
+  {
+  public:
+    void Values(const double*, const double*, const double*, double*, int) const;
+    double ValueGradient(const Vector&, Vector&) const;
+    Vector Normal(const Vector&) const;
+  };
+
+  /*!
+  \brief Compute the value of the field at a set of points.
+
+  The loop is inlined and can be vectorized by the compiler.
+  \param x,y,z Coordinates of the points.
+  \param v Returned values.
+  \param n Number of points.
+  */
+  template<typename Derived>
+  inline void Expression<Derived>::Values(const double* x, const double* y, const double* z, double* v, int n) const
+  {
+    const Derived& f = static_cast<const Derived&>(*this);
+    for (int i = 0; i < n; i++)
+    {
+      v[i] = f.Value(Vector(x[i], y[i], z[i]));
+    }
+  }
+
+  /*!
+  \brief Compute the value and the gradient of the field.
+  \param p Point.
+  \param g Returned gradient.
+  */
+  template<typename Derived>
+  inline double Expression<Derived>::ValueGradient(const Vector& p, Vector& g) const
+  {
+    const Derived& f = static_cast<const Derived&>(*this);
+    g = f.Gradient(p);
+    return f.Value(p);
+  }
+
+  /*!
+  \brief Compute the normal to the surface.
+  \param p Point (should be on the surface).
+  */
+  template<typename Derived>
+  inline Vector Expression<Derived>::Normal(const Vector& p) const
+  {
+    return Normalized(static_cast<const Derived&>(*this).Gradient(p));
+  }
+
+  //! Sphere centered at the origin.
+  class Sphere : public Expression<Sphere>
+  {
+  protected:
+    double r; //!< Radius.
+  public:
+    //! Create a sphere given its radius.
+    explicit Sphere(double r = 1.0) :r(r) {}
+
+    //! Signed distance.
+    double Value(const Vector& p) const
+    {
+      return Norm(p) - r;
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return p / Norm(p);
+    }
+  };
+
+  //! Torus centered at the origin, in the Oxy plane.
+  class Torus : public Expression<Torus>
+  {
+  protected:
+    double a; //!< Radius of the inner circle.
+    double b; //!< Thickness.
+  public:
+    //! Create a torus given its radius and thickness.
+    explicit Torus(double a = 1.0, double b = 0.25) :a(a), b(b) {}
+
+    //! Signed distance.
+    double Value(const Vector& p) const
+    {
+      const double q = sqrt(p[0] * p[0] + p[1] * p[1]) - a;
+      return sqrt(q * q + p[2] * p[2]) - b;
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      const double r = sqrt(p[0] * p[0] + p[1] * p[1]);
+      const double q = r - a;
+      const double l = sqrt(q * q + p[2] * p[2]);
+      return Vector(q * p[0] / (r * l), q * p[1] / (r * l), p[2] / l);
+    }
+  };
+
+  //! Axis aligned box centered at the origin.
+  class Cuboid : public Expression<Cuboid>
+  {
+  protected:
+    Vector h; //!< Half side lengths.
+  public:
+    //! Create a box given its half side lengths.
+    explicit Cuboid(const Vector& h = Vector(1.0)) :h(h) {}
+
+    //! Signed distance.
+    double Value(const Vector& p) const
+    {
+      const Vector q = Abs(p) - h;
+      const Vector o = Vector::Max(q, Vector::Null);
+      return Norm(o) + Math::Min(Math::Max(q[0], q[1], q[2]), 0.0);
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      const Vector q = Abs(p) - h;
+      const Vector s(p[0] < 0.0 ? -1.0 : 1.0, p[1] < 0.0 ? -1.0 : 1.0, p[2] < 0.0 ? -1.0 : 1.0);
+      if (q[0] > 0.0 || q[1] > 0.0 || q[2] > 0.0)
+      {
+        return Normalized(Vector::Max(q, Vector::Null)).Scaled(s);
+      }
+      const int i = (q[0] > q[1]) ? (q[0] > q[2] ? 0 : 2) : (q[1] > q[2] ? 1 : 2);
+      Vector g = Vector::Null;
+      g[i] = s[i];
+      return g;
+    }
+  };
+
+  //! Union of two fields.
+  template<typename A, typename B>
+  class Union : public Expression<Union<A, B> >
+  {
+  protected:
+    A a; //!< First field.
+    B b; //!< Second field.
+  public:
+    //! Create a union.
+    explicit Union(const A& a = A(), const B& b = B()) :a(a), b(b) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      return Math::Min(a.Value(p), b.Value(p));
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return a.Value(p) < b.Value(p) ? a.Gradient(p) : b.Gradient(p);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      Vector gb;
+      const double va = a.ValueGradient(p, g);
+      const double vb = b.ValueGradient(p, gb);
+      if (vb < va)
+      {
+        g = gb;
+        return vb;
+      }
+      return va;
+    }
+  };
+
+  //! Intersection of two fields.
+  template<typename A, typename B>
+  class Intersection : public Expression<Intersection<A, B> >
+  {
+  protected:
+    A a; //!< First field.
+    B b; //!< Second field.
+  public:
+    //! Create an intersection.
+    explicit Intersection(const A& a = A(), const B& b = B()) :a(a), b(b) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      return Math::Max(a.Value(p), b.Value(p));
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return a.Value(p) > b.Value(p) ? a.Gradient(p) : b.Gradient(p);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      Vector gb;
+      const double va = a.ValueGradient(p, g);
+      const double vb = b.ValueGradient(p, gb);
+      if (vb > va)
+      {
+        g = gb;
+        return vb;
+      }
+      return va;
+    }
+  };
+
+  //! Difference of two fields, the second one is removed from the first one.
+  template<typename A, typename B>
+  class Difference : public Expression<Difference<A, B> >
+  {
+  protected:
+    A a; //!< First field.
+    B b; //!< Removed field.
+  public:
+    //! Create a difference.
+    explicit Difference(const A& a = A(), const B& b = B()) :a(a), b(b) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      return Math::Max(a.Value(p), -b.Value(p));
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return a.Value(p) > -b.Value(p) ? a.Gradient(p) : -b.Gradient(p);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      Vector gb;
+      const double va = a.ValueGradient(p, g);
+      const double vb = b.ValueGradient(p, gb);
+      if (-vb > va)
+      {
+        g = -gb;
+        return -vb;
+      }
+      return va;
+    }
+  };
+
+  //! Smooth union of two fields, using the polynomial smooth minimum.
+  template<typename A, typename B>
+  class Blend : public Expression<Blend<A, B> >
+  {
+  protected:
+    A a;      //!< First field.
+    B b;      //!< Second field.
+    double r; //!< Blending radius.
+  public:
+    //! Create a blend.
+    explicit Blend(const A& a = A(), const B& b = B(), double r = 0.5) :a(a), b(b), r(r) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      const double va = a.Value(p);
+      const double vb = b.Value(p);
+      const double h = Math::Max(r - fabs(va - vb), 0.0) / r;
+      return Math::Min(va, vb) - h * h * r * 0.25;
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      const double va = a.Value(p);
+      const double vb = b.Value(p);
+      const double h = Math::Max(r - fabs(va - vb), 0.0) / r;
+      const double w = va < vb ? 1.0 - 0.5 * h : 0.5 * h;
+      return w * a.Gradient(p) + (1.0 - w) * b.Gradient(p);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      Vector gb;
+      const double va = a.ValueGradient(p, g);
+      const double vb = b.ValueGradient(p, gb);
+      const double h = Math::Max(r - fabs(va - vb), 0.0) / r;
+      const double w = va < vb ? 1.0 - 0.5 * h : 0.5 * h;
+      g = w * g + (1.0 - w) * gb;
+      return Math::Min(va, vb) - h * h * r * 0.25;
+    }
+  };
+
+  //! Translated field.
+  template<typename A>
+  class Translate : public Expression<Translate<A> >
+  {
+  protected:
+    A a;      //!< Field.
+    Vector t; //!< Translation.
+  public:
+    //! Create a translation.
+    explicit Translate(const A& a = A(), const Vector& t = Vector::Null) :a(a), t(t) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      return a.Value(p - t);
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return a.Gradient(p - t);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      return a.ValueGradient(p - t, g);
+    }
+  };
+
+  //! Uniformly scaled field.
+  template<typename A>
+  class Scale : public Expression<Scale<A> >
+  {
+  protected:
+    A a;      //!< Field.
+    double s; //!< Scaling factor, should be positive.
+  public:
+    //! Create a scaling.
+    explicit Scale(const A& a = A(), double s = 1.0) :a(a), s(s) {}
+
+    //! Value.
+    double Value(const Vector& p) const
+    {
+      return s * a.Value(p / s);
+    }
+
+    //! Gradient.
+    Vector Gradient(const Vector& p) const
+    {
+      return a.Gradient(p / s);
+    }
+
+    //! Value and gradient.
+    double ValueGradient(const Vector& p, Vector& g) const
+    {
+      return s * a.ValueGradient(p / s, g);
+    }
+  };
+}
@@ -0,0 +1,147 @@
+// Implicit tree
+
+#pragma once
+
+#include "implicits.h"
+
+class ImplicitNode : public AnalyticScalarField
+{
+protected:
+  Box box;  //!< Bounding box of the object.
+  double k; //!< Lipschitz bound.
+public:
+  explicit ImplicitNode(const Box&, double = 1.0);
+
+  virtual double Value(const Vector&) const = 0;
+  virtual double ValueGradient(const Vector&, Vector&) const = 0;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double Lipschitz() const;
+  virtual void Update();
+
+  Box GetBox() const;
+  double Bound(const Vector&) const;
+};
+
+/*!
+\brief Return the bounding box of the object.
+*/
+inline Box ImplicitNode::GetBox() const
+{
+  return box;
+}
+
+/*!
+\brief Compute a lower bound of the field value, i.e. the distance to the bounding box.
+
+The bound is null inside the box.
+\param p Point.
+*/
+inline double ImplicitNode::Bound(const Vector& p) const
+{
+  return box.Distance(p);
+}
+
+class ImplicitPrimitive : public ImplicitNode
+{
+protected:
+  const AnalyticScalarField* field; //!< Field function.
+public:
+  explicit ImplicitPrimitive(const AnalyticScalarField*, const Box&);
+  ~ImplicitPrimitive();
+
+  virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+};
+
+class ImplicitOperator : public ImplicitNode
+{
+protected:
+  ImplicitNode* a; //!< Left sub-tree.
+  ImplicitNode* b; //!< Right sub-tree.
+public:
+  explicit ImplicitOperator(ImplicitNode*, ImplicitNode*, const Box&);
+  ~ImplicitOperator();
+
+  virtual void Update();
+};
+
+class ImplicitUnion : public ImplicitOperator
+{
+public:
+  explicit ImplicitUnion(ImplicitNode*, ImplicitNode*);
+
+  virtual double Value(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual void Update();
+
+  static ImplicitNode* Create(std::vector<ImplicitNode*>);
+};
+
+class ImplicitIntersection : public ImplicitOperator
+{
+public:
+  explicit ImplicitIntersection(ImplicitNode*, ImplicitNode*);
+
+  virtual double Value(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual void Update();
+};
+
+class ImplicitDifference : public ImplicitOperator
+{
+public:
+  explicit ImplicitDifference(ImplicitNode*, ImplicitNode*);
+
+  virtual double Value(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual void Update();
+};
+
+class ImplicitBlend : public ImplicitOperator
+{
+protected:
+  double r; //!< Blending radius.
+public:
+  explicit ImplicitBlend(ImplicitNode*, ImplicitNode*, double);
+
+  virtual double Value(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual void Update();
+};
+
+class ImplicitTransform : public ImplicitNode
+{
+protected:
+  ImplicitNode* e; //!< Sub-tree.
+  Vector r[3];     //!< Rows of the linear part of the transform.
+  Vector ri[3];    //!< Rows of the inverse of the linear part.
+  Vector t;        //!< Translation.
+  double s;        //!< Scaling of the field, norm of the linear part.
+public:
+  explicit ImplicitTransform(ImplicitNode*, const Vector&, const Vector&, const Vector&, const Vector& = Vector::Null);
+  ~ImplicitTransform();
+
+  virtual double Value(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual void Update();
+
+  void SetTranslation(const Vector&);
+
+  static ImplicitTransform* Translation(ImplicitNode*, const Vector&);
+  static ImplicitTransform* Rotation(ImplicitNode*, const Vector&, double);
+  static ImplicitTransform* Scaling(ImplicitNode*, const Vector&);
+protected:
+  Vector Local(const Vector&) const;
+};
+
+/*!
+\brief Transform a point into the frame of the sub-tree.
+\param p Point.
+*/
+inline Vector ImplicitTransform::Local(const Vector& p) const
+{
+  Vector q = p - t;
+  return Vector(ri[0] * q, ri[1] * q, ri[2] * q);
+}
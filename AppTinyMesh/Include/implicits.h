@@ -2,28 +2,938 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#ifdef TINYMESH_STATISTICS
+#include <chrono>
+#endif
+#include <string>
+#include <unordered_map>
 
 #include "mesh.h"
+#include "ray.h"
+
+class Camera;
+class Color;
 
 class AnalyticScalarField
 {
+public:
+  //! Methods for computing the vertices on straddling edges.
+  enum RootFinder
+  {
+    Bisection, //!< Linear interpolation followed by bisection, the default.
+    Linear,    //!< Linear interpolation only, no evaluation.
+    Secant,    //!< Secant method, safeguarded by the bracketing interval.
+    Illinois,  //!< Illinois variant of the regula falsi.
+    Newton     //!< Newton method along the edge using the gradient, safeguarded by the bracketing interval.
+  };
+
+  //! Receiver of the batches of geometry of AnalyticScalarField::PolygonizeStream(): vertices, normals and triangles with global vertex indexes.
+  typedef std::function<void(const VertexArray&, const VertexArray&, const std::vector<int>&)> Sink;
+
+  //! Number of field evaluations of a polygonization, per phase.
+  struct Evaluations
+  {
+    long long classification = 0; //!< Samples at grid nodes.
+    long long roots = 0;          //!< Evaluations for computing the vertices on straddling edges.
+    long long normals = 0;        //!< Gradient queries for the normals at vertices.
+
+    //! Accumulate counters.
+    Evaluations& operator+= (const Evaluations& e)
+    {
+      classification += e.classification;
+      roots += e.roots;
+      normals += e.normals;
+      return *this;
+    }
+  };
+
+#ifdef TINYMESH_STATISTICS
+  /*!
+  \brief Instrumentation of a polygonization.
+
+  The instrumentation only exists if the code is compiled with TINYMESH_STATISTICS defined,
+  otherwise the polygonization has neither the counters nor their overhead.
+  */
+  struct Statistics
+  {
+    Evaluations evaluations;   //!< Field evaluations per phase.
+    long long cells = 0;       //!< Straddling cells.
+    long long iterations = 0;  //!< Lockstep iterations of the root finder, summed over the batches of straddling edges.
+    std::vector<double> slabs; //!< Wall time per slab, in milliseconds.
+    long long bytes = 0;       //!< Bytes allocated for the working arrays and the geometry.
+
+    //! Accumulate counters, the timings of the slabs are appended.
+    Statistics& operator+= (const Statistics& s)
+    {
+      evaluations += s.evaluations;
+      cells += s.cells;
+      iterations += s.iterations;
+      slabs.insert(slabs.end(), s.slabs.begin(), s.slabs.end());
+      bytes += s.bytes;
+      return *this;
+    }
+  };
+#endif
 protected:
+  RootFinder finder = Bisection;   //!< Method for the vertices on straddling edges.
+  int iterations = 64;             //!< Maximum number of iterations of the root finder.
+  mutable Evaluations evaluations; //!< Counters of the last polygonization, not shared between threads.
+#ifdef TINYMESH_STATISTICS
+  mutable Statistics statistics;   //!< Instrumentation of the last polygonization, not shared between threads.
+#endif
 public:
   AnalyticScalarField();
+  //! Empty.
+  virtual ~AnalyticScalarField() {}
   virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
   virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
 
   // Normal
   virtual Vector Normal(const Vector&) const;
 
   // Dichotomy
   Vector Dichotomy(Vector, Vector, double, double, double, const double& = 1.0e-4) const;
+  void Dichotomy(int, const Vector*, const Vector*, const double*, const double*, double, Vector*, const double& = 1.0e-4) const;
+
+  // Root finding
+  void SetRootFinder(RootFinder, int = 64);
+  RootFinder GetRootFinder() const;
+  void Roots(int, const Vector*, const Vector*, const double*, const double*, double, Vector*, const double& = 1.0e-4) const;
+  const Evaluations& GetEvaluations() const;
+#ifdef TINYMESH_STATISTICS
+  const Statistics& GetStatistics() const;
+#endif
 
   virtual void Polygonize(int, Mesh&, const Box&, const double& = 1e-4) const;
+  template<typename Field>
+  static void Polygonize(const Field&, int, Mesh&, const Box&, const double& = 1e-4, RootFinder = Bisection, int = 64, Evaluations* = nullptr
+#ifdef TINYMESH_STATISTICS
+    , Statistics* = nullptr
+#endif
+    );
+  void Polygonize(int, int, int, Mesh&, const Box&, const double& = 1e-4) const;
+  template<typename Field>
+  static void Polygonize(const Field&, int, int, int, Mesh&, const Box&, const double& = 1e-4, RootFinder = Bisection, int = 64, Evaluations* = nullptr
+#ifdef TINYMESH_STATISTICS
+    , Statistics* = nullptr
+#endif
+    );
+  static void Resolution(const Box&, const double&, int&, int&, int&);
+  void Polygonize(int, const std::vector<double>&, std::vector<Mesh>&, const Box&, const double& = 1e-4) const;
+  void Polygonize(int, int, int, const std::vector<double>&, std::vector<Mesh>&, const Box&, const double& = 1e-4) const;
+  template<typename Field>
+  static void PolygonizeLevels(const Field&, int, int, int, const std::vector<double>&, std::vector<Mesh>&, const Box&, const double& = 1e-4, RootFinder = Bisection, int = 64, Evaluations* = nullptr
+#ifdef TINYMESH_STATISTICS
+    , Statistics* = nullptr
+#endif
+    );
+  static long long PolygonizeMemory(int, int, int);
+  void PolygonizeParallel(int, Mesh&, const Box&, int = 0, const double& = 1e-4) const;
+  std::vector<double> PolygonizeScaling(int, const Box&, int = 0, const double& = 1e-4) const;
+  void PolygonizeOctree(int, Mesh&, const Box&, double = 0.0, const double& = 1e-4) const;
+  void PolygonizeStream(int, const Box&, const Sink&, int = 16, const double& = 1e-4) const;
+  bool PolygonizeStream(int, const Box&, const std::string&, int = 16, const double& = 1e-4) const;
+
+  // Ray intersection
+  bool Intersect(const Ray&, const Box&, double&, const double& = 1e-4) const;
+  void Intersect(int, const Ray*, const Box&, double*, char*, const double& = 1e-4) const;
+  std::vector<Color> Render(const Camera&, int, int, const Box&, int = 0, const double& = 1e-4) const;
+protected:
+  template<typename Field>
+  struct Level;
+  struct Straddling;
+  struct OctreeCache;
+  void PolygonizeOctreeNode(OctreeCache&, int, int, int, int) const;
+  static long long PolygonizeVertexes(int, int, int);
+  template<typename Field>
+  static void SamplePlane(const Field&, int, int, const Vector&, const Vector&, Vector*, double*);
+  template<typename Field>
+  static int Dichotomy(const Field&, int, const Vector*, const Vector*, const double*, const double*, double, Vector*, const double&, int);
+  template<typename Field>
+  static long long Roots(const Field&, RootFinder, int, int, const Vector*, const Vector*, const double*, const double*, double, Vector*, const double&, long long* = nullptr);
+  template<typename Field>
+  static void PolygonizeSlab(const Field&, int, int, int, int, const Box&, const Vector&, const double&, RootFinder, int, Evaluations&, VertexArray&, VertexArray&, std::vector<int>&, std::vector<int>&
+#ifdef TINYMESH_STATISTICS
+    , Statistics* = nullptr
+#endif
+    );
+  template<typename Field>
+  static void PolygonizeEdges(const Field&, int, int, int, int, const Vector*, const double*, const Vector*, const double*, double, const double&, RootFinder, int, Evaluations&, Straddling&, VertexArray&, VertexArray&, int*, long long* = nullptr);
+  static long long PolygonizeLayer(int, int, const double*, const double*, const int*, const int*, const int*, const int*, const int*, std::vector<int>&);
+  static int CubeIndex(const double*);
+  static int CubeTriangles(int, const int*, std::vector<int>&);
 protected:
   static const double Epsilon; //!< Epsilon value for partial derivatives
 protected:
   static int TriangleTable[256][16]; //!< Two dimensionnal array storing the straddling edges for every marching cubes configuration.
   static int edgeTable[256];    //!< Array storing straddling edges for every marching cubes configuration.
+  static const int CubeEdge[12][3]; //!< Edges of a cell given by their end corners and their axis, in the order of the triangle table.
+};
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface of a field function.
+
+The marching cubes loop is instantiated for the type of the field, so that static field
+functions such as the expression templates of implicit-static.h are fully inlined.
+The field should provide batched evaluation Values(const double*, const double*, const double*, double*, int)
+and Normal(const Vector&), and ValueGradient(const Vector&, Vector&) for the Newton root finder.
+
+The grid has n nodes along every axis, this is the per-axis polygonization with nx=ny=nz=n, so
+that the last plane of nodes lies on the top of the box and no plane is sampled beyond it.
+
+\param f Field function.
+\param n Discretization parameter.
+\param g Returned geometry.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param finder Method for computing vertices on straddling edges.
+\param iterations Maximum number of iterations of the root finder.
+\param count Returned number of field evaluations per phase, if not null.
+\param stats Instrumentation, accumulated if not null, only if TINYMESH_STATISTICS is defined.
+*/
+template<typename Field>
+inline void AnalyticScalarField::Polygonize(const Field& f, int n, Mesh& g, const Box& box, const double& epsilon, RootFinder finder, int iterations, Evaluations* count
+#ifdef TINYMESH_STATISTICS
+  , Statistics* stats
+#endif
+)
+{
+#ifdef TINYMESH_STATISTICS
+  Polygonize(f, n, n, n, g, box, epsilon, finder, iterations, count, stats);
+#else
+  Polygonize(f, n, n, n, g, box, epsilon, finder, iterations, count);
+#endif
+}
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface of a field function on a grid with a resolution per axis.
+
+Thin or elongated boxes can be sampled with as many nodes along every axis as needed, use AnalyticScalarField::Resolution()
+to derive the resolution from a target cell size, and AnalyticScalarField::PolygonizeMemory() to estimate the memory beforehand.
+
+\param f Field function.
+\param nx,ny,nz Number of grid nodes along each axis, at least 2.
+\param g Returned geometry, with the storage it has on entry.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param finder Method for computing vertices on straddling edges.
+\param iterations Maximum number of iterations of the root finder.
+\param count Returned number of field evaluations per phase, if not null.
+\param stats Instrumentation, accumulated if not null, only if TINYMESH_STATISTICS is defined.
+*/
+template<typename Field>
+inline void AnalyticScalarField::Polygonize(const Field& f, int nx, int ny, int nz, Mesh& g, const Box& box, const double& epsilon, RootFinder finder, int iterations, Evaluations* count
+#ifdef TINYMESH_STATISTICS
+  , Statistics* stats
+#endif
+)
+{
+  // Build the geometry with the storage of the returned mesh
+  VertexArray vertex(g.GetPrecision());
+  VertexArray normal(g.GetPrecision());
+  std::vector<int> triangle;
+
+  // Modest reservation, the arrays grow with the surface
+  const int nv = int(std::min(PolygonizeVertexes(nx, ny, nz), (long long)(20000)));
+  vertex.reserve(nv);
+  normal.reserve(nv);
+  triangle.reserve(6 * nv);
+
+  // Diagonal of a cell
+  const Vector diagonal = box.Diagonal();
+  const Vector d(diagonal[0] / (nx - 1), diagonal[1] / (ny - 1), diagonal[2] / (nz - 1));
+
+  std::vector<int> top;
+  Evaluations e;
+#ifdef TINYMESH_STATISTICS
+  PolygonizeSlab(f, nx, ny, 0, nz - 1, box, d, epsilon, finder, iterations, e, vertex, normal, triangle, top, stats);
+#else
+  PolygonizeSlab(f, nx, ny, 0, nz - 1, box, d, epsilon, finder, iterations, e, vertex, normal, triangle, top);
+#endif
+  if (count)
+  {
+    *count = e;
+  }
+
+  std::vector<int> normals = triangle;
+
+  g = Mesh(vertex, normal, triangle, normals);
+}
+
+/*!
+\brief Field function offset by an iso-value, so that the iso-surface becomes the zero set.
+
+This adapter is used for computing the vertices of several iso-surfaces of the same field.
+*/
+template<typename Field>
+struct AnalyticScalarField::Level
+{
+  const Field& f; //!< Field function.
+  double iso;     //!< Iso-value.
+
+  //! Compute the offset values at a set of points.
+  void Values(const double* x, const double* y, const double* z, double* v, int n) const
+  {
+    f.Values(x, y, z, v, n);
+    for (int i = 0; i < n; i++)
+    {
+      v[i] -= iso;
+    }
+  }
+
+  //! Compute the offset value and the gradient.
+  double ValueGradient(const Vector& p, Vector& g) const
+  {
+    return f.ValueGradient(p, g) - iso;
+  }
+
+  //! Compute the normal, which is not changed by the offset.
+  Vector Normal(const Vector& p) const
+  {
+    return f.Normal(p);
+  }
+};
+
+/*!
+\brief Straddling edges of a plane of the grid, gathered so that their vertices are computed in a single batch.
+*/
+struct AnalyticScalarField::Straddling
+{
+  std::vector<Vector> a, b, c; //!< End vertices of the edges and returned vertices.
+  std::vector<double> va, vb;  //!< Field values at the end vertices.
+  std::vector<int> e;          //!< Index of the edges in the plane.
+
+  //! Allocate the arrays for a plane with a given number of nodes.
+  explicit Straddling(int n) : a(n), b(n), c(n), va(n), vb(n), e(n) {}
+};
+
+/*!
+\brief Compute the polygonal meshes approximating several iso-surfaces of a field function, with a single sampling of the grid.
+
+The grid is traversed once and every plane is sampled once, then every iso-value runs the straddling edges and the cells
+of AnalyticScalarField::PolygonizeSlab() on the offset samples, with the Level adapter for the root finder.
+For an iso-value of 0, the mesh is the same as the one of AnalyticScalarField::Polygonize().
+
+\param f Field function.
+\param nx,ny,nz Number of grid nodes along each axis, at least 2.
+\param levels Iso-values.
+\param g Returned geometry, one mesh per iso-value, with the storage of its first mesh on entry, double precision if empty.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param finder Method for computing vertices on straddling edges.
+\param iterations Maximum number of iterations of the root finder.
+\param count Returned number of field evaluations per phase, if not null.
+\param stats Instrumentation of all the levels as a single slab, accumulated if not null, only if TINYMESH_STATISTICS is defined.
+*/
+template<typename Field>
+inline void AnalyticScalarField::PolygonizeLevels(const Field& f, int nx, int ny, int nz, const std::vector<double>& levels, std::vector<Mesh>& g, const Box& box, const double& epsilon, RootFinder finder, int iterations, Evaluations* count
+#ifdef TINYMESH_STATISTICS
+  , Statistics* stats
+#endif
+)
+{
+#ifdef TINYMESH_STATISTICS
+  const auto start = std::chrono::high_resolution_clock::now();
+  long long cells = 0;
+  long long* steps = stats ? &stats->iterations : nullptr;
+#else
+  long long* steps = nullptr;
+#endif
+
+  const int nl = int(levels.size());
+  const int size = nx * ny;
+
+  // Diagonal of a cell
+  const Vector diagonal = box.Diagonal();
+  const Vector d(diagonal[0] / (nx - 1), diagonal[1] / (ny - 1), diagonal[2] / (nz - 1));
+
+  // Intensities and vertices of the lower and upper planes, and their values offset by the current level
+  std::vector<double> a(size), b(size);
+  std::vector<double> la(size), lb(size);
+  std::vector<Vector> u(size), v(size);
+
+  // Edges, for every level
+  std::vector<int> eax(size_t(nl) * size), eay(size_t(nl) * size), ebx(size_t(nl) * size), eby(size_t(nl) * size), ez(size);
+
+  // Geometry, for every level
+  const VertexArray::Precision precision = g.empty() ? VertexArray::Double : g.front().GetPrecision();
+  std::vector<VertexArray> vertex(nl, VertexArray(precision)), normal(nl, VertexArray(precision));
+  std::vector<std::vector<int> > triangle(nl);
+
+  Straddling straddling(size);
+  Evaluations e;
+
+  // Offset the samples of a plane by a level
+  auto offset = [&](const std::vector<double>& p, std::vector<double>& q, double iso)
+    {
+      for (int i = 0; i < size; i++)
+      {
+        q[i] = p[i] - iso;
+      }
+    };
+
+  double za = 0.0;
+  SamplePlane(f, nx, ny, box[0], d, u.data(), a.data());
+  e.classification += size;
+
+  for (int l = 0; l < nl; l++)
+  {
+    const Level<Field> level{ f, levels[l] };
+    offset(a, la, levels[l]);
+    PolygonizeEdges(level, nx, ny, 1, 0, u.data(), la.data(), u.data(), la.data(), d[0], epsilon, finder, iterations, e, straddling, vertex[l], normal[l], &eax[size_t(l) * size], steps);
+    PolygonizeEdges(level, nx, ny, 0, 1, u.data(), la.data(), u.data(), la.data(), d[1], epsilon, finder, iterations, e, straddling, vertex[l], normal[l], &eay[size_t(l) * size], steps);
+  }
+
+  for (int k = 0; k < nz - 1; k++)
+  {
+    const double zb = za + d[2];
+    SamplePlane(f, nx, ny, box[0] + Vector(0.0, 0.0, zb), d, v.data(), b.data());
+    e.classification += size;
+
+    for (int l = 0; l < nl; l++)
+    {
+      const Level<Field> level{ f, levels[l] };
+      int* lax = &eax[size_t(l) * size];
+      int* lay = &eay[size_t(l) * size];
+      int* lbx = &ebx[size_t(l) * size];
+      int* lby = &eby[size_t(l) * size];
+
+      offset(a, la, levels[l]);
+      offset(b, lb, levels[l]);
+      PolygonizeEdges(level, nx, ny, 1, 0, v.data(), lb.data(), v.data(), lb.data(), d[0], epsilon, finder, iterations, e, straddling, vertex[l], normal[l], lbx, steps);
+      PolygonizeEdges(level, nx, ny, 0, 1, v.data(), lb.data(), v.data(), lb.data(), d[1], epsilon, finder, iterations, e, straddling, vertex[l], normal[l], lby, steps);
+      PolygonizeEdges(level, nx, ny, 0, 0, u.data(), la.data(), v.data(), lb.data(), d[2], epsilon, finder, iterations, e, straddling, vertex[l], normal[l], ez.data(), steps);
+#ifdef TINYMESH_STATISTICS
+      cells +=
+#endif
+        PolygonizeLayer(nx, ny, la.data(), lb.data(), lax, lay, lbx, lby, ez.data(), triangle[l]);
+    }
+
+    std::swap(a, b);
+    std::swap(u, v);
+    std::swap(eax, ebx);
+    std::swap(eay, eby);
+    za = zb;
+  }
+
+  if (count)
+  {
+    *count = e;
+  }
+
+#ifdef TINYMESH_STATISTICS
+  if (stats)
+  {
+    stats->evaluations += e;
+    stats->cells += cells;
+    stats->slabs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+    // Planes of values, offset values and nodes, edges of every level, batch of straddling edges and geometry
+    stats->bytes += (long long)(size) * (4 * sizeof(double) + 2 * sizeof(Vector) + (4 * nl + 1) * sizeof(int));
+    stats->bytes += (long long)(size) * (3 * sizeof(Vector) + 2 * sizeof(double) + sizeof(int));
+    for (int l = 0; l < nl; l++)
+    {
+      stats->bytes += vertex[l].Memory() + normal[l].Memory() + (long long)(triangle[l].capacity() * sizeof(int));
+    }
+  }
+#endif
+
+  g.resize(nl);
+  for (int l = 0; l < nl; l++)
+  {
+    g[l] = Mesh(vertex[l], normal[l], triangle[l], triangle[l]);
+  }
+}
+
+/*!
+\brief Estimate the number of vertices of a polygonization, used for estimating the memory.
+
+The estimate is the number of straddling edges of a surface as large as the faces of the box.
+\param nx,ny,nz Number of grid nodes along each axis.
+*/
+inline long long AnalyticScalarField::PolygonizeVertexes(int nx, int ny, int nz)
+{
+  return 2 * ((long long)(nx) * ny + (long long)(ny) * nz + (long long)(nz) * nx);
+}
+
+/*!
+\brief Sample the field on an Oxy plane of the grid.
+
+The field is evaluated one row at a time with the batched evaluation of the field.
+
+\param f Field function.
+\param nx,ny Number of grid nodes along x and y.
+\param o Origin of the plane.
+\param d Diagonal of a cell.
+\param u Returned grid nodes.
+\param a Returned field values.
+*/
+template<typename Field>
+inline void AnalyticScalarField::SamplePlane(const Field& f, int nx, int ny, const Vector& o, const Vector& d, Vector* u, double* a)
+{
+  std::vector<double> x(ny), y(ny), z(ny);
+  for (int i = 0; i < nx; i++)
+  {
+    for (int j = 0; j < ny; j++)
+    {
+      u[i * ny + j] = o + Vector(i * d[0], j * d[1], 0.0);
+      x[j] = u[i * ny + j][0];
+      y[j] = u[i * ny + j][1];
+      z[j] = u[i * ny + j][2];
+    }
+    f.Values(x.data(), y.data(), z.data(), a + i * ny, ny);
+  }
+}
+
+/*!
+\brief Compute the intersection between a set of segments of the same length and an implicit surface.
+
+All the segments are refined in lockstep, every iteration evaluates the field at all the
+midpoints with a single batched evaluation. The result is the same as
+calling AnalyticScalarField::Dichotomy() for every segment.
+
+\param f Field function.
+\param n Number of segments.
+\param a,b End vertices of the segments straddling the surface.
+\param va,vb Field function value at those end vertices.
+\param length Distance between vertices.
+\param c Returned points on the implicit surface.
+\param epsilon Precision.
+\param iterations Maximum number of iterations.
+\return The number of iterations, every iteration evaluates the field once per segment.
+*/
+template<typename Field>
+inline int AnalyticScalarField::Dichotomy(const Field& f, int n, const Vector* a, const Vector* b, const double* va, const double* vb, double length, Vector* c, const double& epsilon, int iterations)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  std::vector<Vector> pa(a, a + n);
+  std::vector<Vector> pb(b, b + n);
+  std::vector<int> ia(n);
+  std::vector<double> x(n), y(n), z(n), vc(n);
+
+  // Get an accurate first guess
+  for (int i = 0; i < n; i++)
+  {
+    ia[i] = va[i] > 0.0 ? 1 : -1;
+    c[i] = (vb[i] * a[i] - va[i] * b[i]) / (vb[i] - va[i]);
+  }
+
+  int it = 0;
+  while (length > epsilon && it < iterations)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      x[i] = c[i][0];
+      y[i] = c[i][1];
+      z[i] = c[i][2];
+    }
+    f.Values(x.data(), y.data(), z.data(), vc.data(), n);
+
+    for (int i = 0; i < n; i++)
+    {
+      int ic = vc[i] > 0.0 ? 1 : -1;
+      if (ia[i] + ic == 0)
+      {
+        pb[i] = c[i];
+      }
+      else
+      {
+        ia[i] = ic;
+        pa[i] = c[i];
+      }
+      c[i] = 0.5 * (pa[i] + pb[i]);
+    }
+    length *= 0.5;
+    it++;
+  }
+  return it;
+}
+
+/*!
+\brief Compute the intersection between a set of segments of the same length and an implicit surface with a given method.
+
+All methods start from the linear interpolation of the end values. Iterative methods work on the parameter along
+every segment and keep the bracketing interval: a step that leaves the interval is replaced by a bisection step.
+A segment is converged when its last step is shorter than epsilon, and the remaining segments are refined in lockstep
+with batched evaluations. The Bisection method is the same as AnalyticScalarField::Dichotomy().
+
+\param f Field function.
+\param finder Method.
+\param iterations Maximum number of iterations.
+\param n Number of segments.
+\param a,b End vertices of the segments straddling the surface.
+\param va,vb Field function value at those end vertices.
+\param length Distance between vertices.
+\param c Returned points on the implicit surface.
+\param epsilon Precision.
+\param steps Number of lockstep iterations, incremented if not null.
+\return The number of field evaluations.
+*/
+template<typename Field>
+inline long long AnalyticScalarField::Roots(const Field& f, RootFinder finder, int iterations, int n, const Vector* a, const Vector* b, const double* va, const double* vb, double length, Vector* c, const double& epsilon, long long* steps)
+{
+  if (finder == Bisection)
+  {
+    const int it = Dichotomy(f, n, a, b, va, vb, length, c, epsilon, iterations);
+    if (steps)
+    {
+      *steps += it;
+    }
+    return (long long)(n) * it;
+  }
+
+  // Linear interpolation
+  for (int i = 0; i < n; i++)
+  {
+    c[i] = (vb[i] * a[i] - va[i] * b[i]) / (vb[i] - va[i]);
+  }
+  if (finder == Linear || n == 0)
+  {
+    return 0;
+  }
+
+  // Parameters of the current and previous iterates, bracketing interval and values
+  std::vector<double> t(n), tp(n, 0.0), fp(va, va + n);
+  std::vector<double> t0(n, 0.0), t1(n, 1.0), f0(va, va + n), f1(vb, vb + n);
+  std::vector<int> side(n, 0);
+  for (int i = 0; i < n; i++)
+  {
+    t[i] = va[i] / (va[i] - vb[i]);
+  }
+
+  std::vector<int> active(n);
+  for (int i = 0; i < n; i++)
+  {
+    active[i] = i;
+  }
+
+  std::vector<double> x(n), y(n), z(n), v(n);
+  std::vector<Vector> g(finder == Newton ? n : 0);
+  long long count = 0;
+
+  for (int it = 0; it < iterations && !active.empty(); it++)
+  {
+    const int m = int(active.size());
+    if (finder == Newton)
+    {
+      for (int k = 0; k < m; k++)
+      {
+        v[k] = f.ValueGradient(c[active[k]], g[k]);
+      }
+    }
+    else
+    {
+      for (int k = 0; k < m; k++)
+      {
+        x[k] = c[active[k]][0];
+        y[k] = c[active[k]][1];
+        z[k] = c[active[k]][2];
+      }
+      f.Values(x.data(), y.data(), z.data(), v.data(), m);
+    }
+    count += m;
+    if (steps)
+    {
+      (*steps)++;
+    }
+
+    int q = 0;
+    for (int k = 0; k < m; k++)
+    {
+      const int i = active[k];
+      const double vc = v[k];
+      if (vc == 0.0)
+      {
+        continue;
+      }
+
+      // Update the bracketing interval, Illinois halves the value of an end point retained twice
+      if ((vc < 0.0) == (f0[i] < 0.0))
+      {
+        t0[i] = t[i]; f0[i] = vc;
+        if (finder == Illinois && side[i] == -1) f1[i] *= 0.5;
+        side[i] = -1;
+      }
+      else
+      {
+        t1[i] = t[i]; f1[i] = vc;
+        if (finder == Illinois && side[i] == 1) f0[i] *= 0.5;
+        side[i] = 1;
+      }
+
+      double tn;
+      if (finder == Secant)
+      {
+        tn = t[i] - vc * (t[i] - tp[i]) / (vc - fp[i]);
+        tp[i] = t[i];
+        fp[i] = vc;
+      }
+      else if (finder == Illinois)
+      {
+        tn = (t0[i] * f1[i] - t1[i] * f0[i]) / (f1[i] - f0[i]);
+      }
+      else
+      {
+        tn = t[i] - vc / (g[k] * (b[i] - a[i]));
+      }
+
+      // Safeguard, also catches null derivatives
+      if (!(tn > t0[i] && tn < t1[i]))
+      {
+        tn = 0.5 * (t0[i] + t1[i]);
+      }
+
+      const bool converged = fabs(tn - t[i]) * length < epsilon;
+      t[i] = tn;
+      c[i] = a[i] + tn * (b[i] - a[i]);
+      if (!converged)
+      {
+        active[q++] = i;
+      }
+    }
+    active.resize(q);
+  }
+  return count;
+}
+
+/*!
+\brief Polygonize the layers of cells between two z-planes of the grid.
+
+Vertices are created on the straddling edges of the planes k0+1 to k1 and on the vertical edges in between.
+The edges of the bottom plane k0 are created only for the first slab: otherwise they belong to the slab below,
+and triangles reference them with negative indexes -1-i, where i indexes the top array of that slab.
+
+\param f Field function.
+\param nx,ny Number of grid nodes along x and y.
+\param k0,k1 Range of layers.
+\param box %Box defining the region that will be polygonized.
+\param d Diagonal of a cell.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param finder Method for computing vertices on straddling edges.
+\param iterations Maximum number of iterations of the root finder.
+\param count Field evaluations, incremented.
+\param vertex, normal, triangle Returned geometry, with indexes local to the slab.
+\param top Returned indexes of the vertices on the x and y edges of the top plane.
+\param stats Instrumentation, accumulated if not null, only if TINYMESH_STATISTICS is defined.
+*/
+template<typename Field>
+inline void AnalyticScalarField::PolygonizeSlab(const Field& f, int nx, int ny, int k0, int k1, const Box& box, const Vector& d, const double& epsilon, RootFinder finder, int iterations, Evaluations& count, VertexArray& vertex, VertexArray& normal, std::vector<int>& triangle, std::vector<int>& top
+#ifdef TINYMESH_STATISTICS
+  , Statistics* stats
+#endif
+)
+{
+#ifdef TINYMESH_STATISTICS
+  const auto start = std::chrono::high_resolution_clock::now();
+  const long long capacity = vertex.Memory() + normal.Memory() + (long long)(triangle.capacity() * sizeof(int));
+  const Evaluations initial = count;
+  long long cells = 0;
+  long long* steps = stats ? &stats->iterations : nullptr;
+#else
+  long long* steps = nullptr;
+#endif
+
+  const int size = nx * ny;
+
+  // Intensities
+  std::vector<double> a(size), b(size);
+
+  // Vertex
+  std::vector<Vector> u(size), v(size);
+
+  // Edges
+  std::vector<int> eax(size), eay(size), ebx(size), eby(size), ez(size);
+
+  Straddling straddling(size);
+
+  // Accumulate the height of the planes exactly as a single slab would, so that shared planes get the same samples
+  double za = 0.0;
+  for (int k = 0; k < k0; k++)
+  {
+    za += d[2];
+  }
+
+  // Compute field inside lower Oxy plane
+  SamplePlane(f, nx, ny, box[0] + Vector(0.0, 0.0, za), d, u.data(), a.data());
+  count.classification += size;
+
+  if (k0 == 0)
+  {
+    // Compute straddling edges inside lower Oxy plane
+    PolygonizeEdges(f, nx, ny, 1, 0, u.data(), a.data(), u.data(), a.data(), d[0], epsilon, finder, iterations, count, straddling, vertex, normal, eax.data(), steps);
+    PolygonizeEdges(f, nx, ny, 0, 1, u.data(), a.data(), u.data(), a.data(), d[1], epsilon, finder, iterations, count, straddling, vertex, normal, eay.data(), steps);
+  }
+  else
+  {
+    // Edges of the lower plane belong to the previous slab
+    for (int i = 0; i < size; i++)
+    {
+      eax[i] = -1 - i;
+      eay[i] = -1 - (size + i);
+    }
+  }
+
+  // For all layers
+  for (int k = k0; k < k1; k++)
+  {
+    double zb = za + d[2];
+    SamplePlane(f, nx, ny, box[0] + Vector(0.0, 0.0, zb), d, v.data(), b.data());
+    count.classification += size;
+
+    // Compute straddling edges inside upper Oxy plane, then vertical straddling edges
+    PolygonizeEdges(f, nx, ny, 1, 0, v.data(), b.data(), v.data(), b.data(), d[0], epsilon, finder, iterations, count, straddling, vertex, normal, ebx.data(), steps);
+    PolygonizeEdges(f, nx, ny, 0, 1, v.data(), b.data(), v.data(), b.data(), d[1], epsilon, finder, iterations, count, straddling, vertex, normal, eby.data(), steps);
+    PolygonizeEdges(f, nx, ny, 0, 0, u.data(), a.data(), v.data(), b.data(), d[2], epsilon, finder, iterations, count, straddling, vertex, normal, ez.data(), steps);
+
+    // Create mesh
+#ifdef TINYMESH_STATISTICS
+    cells +=
+#endif
+      PolygonizeLayer(nx, ny, a.data(), b.data(), eax.data(), eay.data(), ebx.data(), eby.data(), ez.data(), triangle);
+
+    std::swap(a, b);
+
+    za = zb;
+    std::swap(eax, ebx);
+    std::swap(eay, eby);
+    std::swap(u, v);
+  }
+
+  // Export the edges of the top plane for the next slab
+  top.assign(eax.begin(), eax.end());
+  top.insert(top.end(), eay.begin(), eay.end());
+
+#ifdef TINYMESH_STATISTICS
+  if (stats)
+  {
+    stats->evaluations.classification += count.classification - initial.classification;
+    stats->evaluations.roots += count.roots - initial.roots;
+    stats->evaluations.normals += count.normals - initial.normals;
+    stats->cells += cells;
+    stats->slabs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+    // Planes of values, nodes and edges, batch of straddling edges, top plane and growth of the geometry
+    stats->bytes += (long long)(size) * (2 * sizeof(double) + 2 * sizeof(Vector) + 5 * sizeof(int));
+    stats->bytes += (long long)(size) * (3 * sizeof(Vector) + 2 * sizeof(double) + sizeof(int));
+    stats->bytes += (long long)(top.capacity()) * sizeof(int);
+    stats->bytes += vertex.Memory() + normal.Memory() + (long long)(triangle.capacity() * sizeof(int)) - capacity;
+  }
+#endif
+}
+
+/*!
+\brief Compute the vertices on the straddling edges between two planes of the grid.
+
+The edges join the node (i, j) of the first plane to the node (i+di, j+dj) of the second one, which may be the same plane.
+Their vertices are computed with a single batch of the root finder, appended to the geometry, and their indexes are stored in the edge array.
+\param f Field function.
+\param nx,ny Number of grid nodes along x and y.
+\param di,dj Offset of the second node.
+\param u,a Nodes and field values of the first plane.
+\param v,b Nodes and field values of the second plane.
+\param length Length of the edges.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param finder Method for computing vertices on straddling edges.
+\param iterations Maximum number of iterations of the root finder.
+\param count Field evaluations, incremented.
+\param straddling Working arrays.
+\param vertex, normal Geometry.
+\param edge Returned vertex index of the straddling edges, indexed by their first node.
+\param steps Number of lockstep iterations, incremented if not null.
+*/
+template<typename Field>
+inline void AnalyticScalarField::PolygonizeEdges(const Field& f, int nx, int ny, int di, int dj, const Vector* u, const double* a, const Vector* v, const double* b, double length, const double& epsilon, RootFinder finder, int iterations, Evaluations& count, Straddling& straddling, VertexArray& vertex, VertexArray& normal, int* edge, long long* steps)
+{
+  int ns = 0;
+  for (int i = 0; i < nx - di; i++)
+  {
+    for (int j = 0; j < ny - dj; j++)
+    {
+      const int p = i * ny + j;
+      const int q = (i + di) * ny + j + dj;
+      // We need a xor b, which can be implemented a == !b 
+      if (!((a[p] < 0.0) == !(b[q] >= 0.0)))
+      {
+        straddling.a[ns] = u[p]; straddling.b[ns] = v[q]; straddling.va[ns] = a[p]; straddling.vb[ns] = b[q]; straddling.e[ns] = p;
+        ns++;
+      }
+    }
+  }
+  count.roots += Roots(f, finder, iterations, ns, straddling.a.data(), straddling.b.data(), straddling.va.data(), straddling.vb.data(), length, straddling.c.data(), epsilon, steps);
+  count.normals += ns;
+  for (int h = 0; h < ns; h++)
+  {
+    edge[straddling.e[h]] = int(vertex.size());
+    vertex.push_back(straddling.c[h]);
+    normal.push_back(f.Normal(straddling.c[h]));
+  }
+}
+
+/*!
+\brief Compute the marching cubes configuration of a cell.
+\param v Field values at the corners, the corner c is offset by (c&1, (c>>1)&1, (c>>2)&1).
+*/
+inline int AnalyticScalarField::CubeIndex(const double* v)
+{
+  int cubeindex = 0;
+  for (int c = 0; c < 8; c++)
+  {
+    if (v[c] < 0.0) cubeindex |= 1 << c;
+  }
+  return cubeindex;
+}
+
+/*!
+\brief Append the triangles of a cell.
+\param cubeindex Marching cubes configuration.
+\param e Vertex indexes on the edges of the cell, in the order of AnalyticScalarField::CubeEdge.
+\param triangle Triangles.
+\return The number of triangles.
+*/
+inline int AnalyticScalarField::CubeTriangles(int cubeindex, const int* e, std::vector<int>& triangle)
+{
+  int h = 0;
+  for (; TriangleTable[cubeindex][h] != -1; h += 3)
+  {
+    triangle.push_back(e[TriangleTable[cubeindex][h + 0]]);
+    triangle.push_back(e[TriangleTable[cubeindex][h + 1]]);
+    triangle.push_back(e[TriangleTable[cubeindex][h + 2]]);
+  }
+  return h / 3;
+}
+
+class SphereField : public AnalyticScalarField
+{
+protected:
+  Vector c; //!< Center.
+  double r; //!< Radius.
+public:
+  explicit SphereField(const Vector& = Vector::Null, double = 1.0);
+  explicit SphereField(const Sphere&);
+
+  virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
 };
+
+/*!
+\brief Return the bounding box of the sphere.
+*/
+inline Box SphereField::GetBox() const
+{
+  return Box(c, r);
+}
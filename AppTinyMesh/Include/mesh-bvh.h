@@ -0,0 +1,61 @@
+// Bounding volume hierarchy of a mesh
+
+#pragma once
+
+#include "mesh.h"
+#include "ray-packet.h"
+
+#include <limits>
+
+class MeshBVH
+{
+protected:
+  //! Node of the hierarchy, 32 bytes, stored in depth first order so that the first child of an internal node follows it.
+  struct Node
+  {
+    float box[6];           //!< Lower and upper vertices of the bounding box, rounded outwards.
+    int offset;             //!< Index of the first packet of a leaf, or index of the second child of an internal node.
+    unsigned int count : 30; //!< Number of triangles of a leaf, 0 for an internal node.
+    unsigned int axis : 2;  //!< Split axis of an internal node.
+  };
+  struct Builder;
+protected:
+  std::vector<Node> nodes;         //!< Hierarchy, the root is the first node.
+  std::vector<int> index;          //!< Index of the triangles of the mesh, four per packet in the order of the leaves, -1 for empty lanes.
+  std::vector<TrianglePacket4> packets; //!< Triangles of the leaves, in packets of four.
+public:
+  explicit MeshBVH(const Mesh&, int = 4, int = 0);
+
+  bool Intersect(const Ray&, double&, int&, double = std::numeric_limits<double>::infinity()) const;
+  bool Intersect(const Ray&, double&, double&, double&, int&, double = std::numeric_limits<double>::infinity()) const;
+  bool Occluded(const Ray&, double = std::numeric_limits<double>::infinity()) const;
+
+  void Refit(const Mesh&, int = 0);
+
+  int Nodes() const;
+  Box GetBox() const;
+protected:
+  void Fit(int);
+  static void Round(const Box&, float*);
+};
+
+/*!
+\brief Return the number of nodes of the hierarchy.
+*/
+inline int MeshBVH::Nodes() const
+{
+  return int(nodes.size());
+}
+
+/*!
+\brief Return the bounding box of the mesh.
+*/
+inline Box MeshBVH::GetBox() const
+{
+  if (nodes.empty())
+  {
+    return Box(Vector::Null, 0.0);
+  }
+  const float* b = nodes[0].box;
+  return Box(Vector(b[0], b[1], b[2]), Vector(b[3], b[4], b[5]));
+}
@@ -0,0 +1,55 @@
+// Mesh distance field
+
+#pragma once
+
+#include "implicits.h"
+
+class MeshDistanceField : public AnalyticScalarField
+{
+protected:
+  //! Node of the bounding volume hierarchy, stored in a flat array.
+  struct Node
+  {
+    Box box;   //!< Bounding box.
+    int left;  //!< Index of the first child, the second one follows, or -1 for a leaf.
+    int first; //!< Index of the first triangle of a leaf.
+    int count; //!< Number of triangles of a leaf.
+  };
+protected:
+  std::vector<Triangle> triangles; //!< Triangles, in the order of the leaves of the hierarchy.
+  std::vector<Vector> pseudo;      //!< Pseudo-normals of the face, the three vertices and the three edges of every triangle.
+  std::vector<Node> nodes;         //!< Bounding volume hierarchy, the root is the first node.
+
+  // Narrow band grid
+  Box grid;                  //!< Sampled region.
+  int nx, ny, nz;            //!< Number of grid nodes along each axis.
+  Vector d;                  //!< Diagonal of a cell.
+  double band;               //!< Half width of the narrow band, samples are clamped to this value.
+  std::vector<double> field; //!< Samples, x varies the fastest, empty if not precomputed.
+public:
+  explicit MeshDistanceField(const Mesh&, int = 4);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  double Signed(const Vector&, Vector&) const;
+  Box GetBox() const;
+
+  void Precompute(int, double = 2.0, int = 0);
+protected:
+  void Build(int, int, int, int, std::vector<int>&, const std::vector<Vector>&, const std::vector<Box>&);
+  double Closest(const Vector&, double, Vector&, int&, int&) const;
+  double Trilinear(const Vector&) const;
+  double Trilinear(const Vector&, Vector&) const;
+  static Vector Closest(const Triangle&, const Vector&, int&);
+};
+
+/*!
+\brief Return the bounding box of the mesh.
+*/
+inline Box MeshDistanceField::GetBox() const
+{
+  return nodes[0].box;
+}
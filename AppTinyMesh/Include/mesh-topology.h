@@ -0,0 +1,149 @@
+// Adjacency of a triangle mesh
+
+#pragma once
+
+#include <vector>
+
+class MeshTopology
+{
+protected:
+  int nv;                           //!< Number of vertices.
+  std::vector<int> first;           //!< Index of the first corner of every vertex, and total number of corners.
+  std::vector<int> corners;         //!< Corners of the triangles sharing every vertex, sorted by vertex and then by triangle.
+  std::vector<int> edges;           //!< Pairs of vertex indexes of the edges, the smaller index first.
+  std::vector<unsigned char> shared; //!< Number of triangles sharing every edge, clamped to 255.
+  std::vector<int> edge;            //!< Edge of every half-edge, -1 for degenerate half-edges.
+  std::vector<int> opposite;        //!< Opposite half-edge of every half-edge, -1 for boundary and non-manifold edges.
+  std::vector<char> boundary;       //!< Boundary flag of every vertex.
+public:
+  explicit MeshTopology(const std::vector<int>&, int, int = 0);
+
+  int Vertexes() const;
+  int Edges() const;
+
+  int Valence(int) const;
+  int Corner(int, int) const;
+  const std::vector<int>& First() const;
+  const std::vector<int>& Corners() const;
+
+  int EdgeVertex(int, int) const;
+  int Edge(int) const;
+  int Opposite(int) const;
+  int Shared(int) const;
+
+  bool Boundary(int) const;
+  bool BoundaryEdge(int) const;
+
+  static void BuildCorners(const std::vector<int>&, int, int, std::vector<int>&, std::vector<int>&);
+protected:
+  void BuildEdges(const std::vector<int>&, int);
+};
+
+/*!
+\brief Return the number of vertices.
+*/
+inline int MeshTopology::Vertexes() const
+{
+  return nv;
+}
+
+/*!
+\brief Return the number of edges.
+*/
+inline int MeshTopology::Edges() const
+{
+  return int(edges.size()) / 2;
+}
+
+/*!
+\brief Return the number of triangles sharing a vertex.
+\param v Vertex.
+*/
+inline int MeshTopology::Valence(int v) const
+{
+  return first[v + 1] - first[v];
+}
+
+/*!
+\brief Return a corner of a vertex, the corner 3t+i is the vertex i of the triangle t.
+\param v Vertex.
+\param j Index of the corner, lower than the valence.
+*/
+inline int MeshTopology::Corner(int v, int j) const
+{
+  return corners[first[v] + j];
+}
+
+/*!
+\brief Return the index of the first corner of every vertex in Corners(), with a last entry equal to the number of corners.
+*/
+inline const std::vector<int>& MeshTopology::First() const
+{
+  return first;
+}
+
+/*!
+\brief Return the corners of all the vertices, sorted by vertex and then by triangle.
+*/
+inline const std::vector<int>& MeshTopology::Corners() const
+{
+  return corners;
+}
+
+/*!
+\brief Return a vertex of an edge.
+\param e Edge.
+\param i Vertex, 0 for the smaller index and 1 for the greater.
+*/
+inline int MeshTopology::EdgeVertex(int e, int i) const
+{
+  return edges[2 * e + i];
+}
+
+/*!
+\brief Return the edge of a half-edge.
+
+The half-edge 3t+i goes from the vertex i to the vertex i+1 of the triangle t.
+\param h Half-edge.
+*/
+inline int MeshTopology::Edge(int h) const
+{
+  return edge[h];
+}
+
+/*!
+\brief Return the opposite half-edge, which belongs to the other triangle sharing the edge.
+\param h Half-edge.
+\return The opposite half-edge, -1 if the edge is on the boundary or is shared by more than two triangles.
+*/
+inline int MeshTopology::Opposite(int h) const
+{
+  return opposite[h];
+}
+
+/*!
+\brief Return the number of triangles sharing an edge, clamped to 255.
+\param e Edge.
+*/
+inline int MeshTopology::Shared(int e) const
+{
+  return shared[e];
+}
+
+/*!
+\brief Check whether a vertex is on the boundary, i.e. belongs to an edge of a single triangle.
+\param v Vertex.
+*/
+inline bool MeshTopology::Boundary(int v) const
+{
+  return boundary[v] != 0;
+}
+
+/*!
+\brief Check whether an edge is on the boundary, i.e. belongs to a single triangle.
+\param e Edge.
+*/
+inline bool MeshTopology::BoundaryEdge(int e) const
+{
+  return shared[e] == 1;
+}
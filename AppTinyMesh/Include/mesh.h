@@ -10,6 +10,10 @@
 #include "../capsule.h"
 #include "../matrix.h"
 #include "../HeightField.h"
+#include "vertex-array.h"
+#include "mesh-topology.h"
+
+#include <memory>
 
 
 
@@ -91,15 +95,24 @@ class QString;
 
 class Mesh
 {
+public:
+  //! Weighting of the normals of the triangles sharing a vertex.
+  enum Weighting
+  {
+    Area = 0,  //!< Weight by the area of the triangles.
+    Angle = 1, //!< Weight by the angle of the triangles at the vertex.
+  };
 protected:
-  std::vector<Vector> vertices; //!< Vertices.
-  std::vector<Vector> normals;  //!< Normals.
+  VertexArray vertices; //!< Vertices.
+  VertexArray normals;  //!< Normals.
   std::vector<int> varray;     //!< Vertex indexes.
   std::vector<int> narray;     //!< Normal indexes.
+  mutable std::shared_ptr<const MeshTopology> topology; //!< Adjacency, built on demand.
 public:
-  explicit Mesh();
-  explicit Mesh(const std::vector<Vector>&, const std::vector<int>&);
-  explicit Mesh(const std::vector<Vector>&, const std::vector<Vector>&, const std::vector<int>&, const std::vector<int>&);
+  explicit Mesh(VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const std::vector<Vector>&, const std::vector<int>&, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const std::vector<Vector>&, const std::vector<Vector>&, const std::vector<int>&, const std::vector<int>&, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const VertexArray&, const VertexArray&, const std::vector<int>&, const std::vector<int>&);
   ~Mesh();
 
   void Reserve(int, int, int, int);
@@ -113,6 +126,8 @@ public:
   int Triangles() const;
   int Vertexes() const;
 
+  const MeshTopology& Topology(int = 0) const;
+
   std::vector<int> VertexIndexes() const;
   std::vector<int> NormalIndexes() const;
 
@@ -123,6 +138,12 @@ public:
 
   Box GetBox() const;
 
+  VertexArray::Precision GetPrecision() const;
+  void SetPrecision(VertexArray::Precision);
+
+  const float* VertexCoordinates(int) const;
+  const float* NormalCoordinates(int) const;
+
   void Scale(double);
   void Translation(float x, float y, float z);
   void RotaionX(double deg);
@@ -130,22 +151,25 @@ public:
   void RotaionZ(double deg);
 
   void Merge(Mesh &m);
+  void Resize(int, int);
+  void SetVertex(int, const Vector&, const Vector&);
+  void SetTriangle(int, int, int, int);
 
   void SphereWarp(int h);
   void Terrassement(int x, int y, int w, int h, int d);
 
   void modifyHeight(int x, int y, int h);
 
-  void SmoothNormals();
+  void SmoothNormals(Weighting = Area, int = 0);
 
   // Constructors from core classes
-  explicit Mesh(const Box&);
-  explicit Mesh(const Disk&, int div);  
-  explicit Mesh(const Sphere&, int div);
-  explicit Mesh(const Cylindre& cylindre, int div);
-  explicit Mesh(const Tore& tore, int divR, int divT);
-  explicit Mesh(const Capsule& capsule, int div);
-  explicit Mesh(HeightField hf);
+  explicit Mesh(const Box&, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const Disk&, int div, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const Sphere&, int div, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const Cylindre& cylindre, int div, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const Tore& tore, int divR, int divT, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(const Capsule& capsule, int div, VertexArray::Precision = VertexArray::Double);
+  explicit Mesh(HeightField hf, VertexArray::Precision = VertexArray::Double);
 
 
   void Load(const QString&);
@@ -156,6 +180,8 @@ protected:
   void AddSmoothQuadrangle(int, int, int, int, int, int, int, int);
   void AddQuadrangle(int, int, int, int);
 
+  void Invalidate();
+
 };
 
 /*!
@@ -201,7 +227,7 @@ inline int Mesh::NormalIndex(int t, int i) const
 */
 inline Triangle Mesh::GetTriangle(int i) const
 {
-  return Triangle(vertices.at(varray.at(i * 3 + 0)), vertices.at(varray.at(i * 3 + 1)), vertices.at(varray.at(i * 3 + 2)));
+  return Triangle(vertices[varray.at(i * 3 + 0)], vertices[varray.at(i * 3 + 1)], vertices[varray.at(i * 3 + 2)]);
 }
 
 /*!
@@ -263,3 +289,29 @@ inline Vector Mesh::operator[](int i) const
   return vertices[i];
 }
 
+/*!
+\brief Return the storage of the vertices and normals.
+*/
+inline VertexArray::Precision Mesh::GetPrecision() const
+{
+  return vertices.GetPrecision();
+}
+
+/*!
+\brief Return the array of a coordinate of the vertices in single precision storage, nullptr in double precision.
+\param i Axis.
+*/
+inline const float* Mesh::VertexCoordinates(int i) const
+{
+  return vertices.Coordinates(i);
+}
+
+/*!
+\brief Return the array of a coordinate of the normals in single precision storage, nullptr in double precision.
+\param i Axis.
+*/
+inline const float* Mesh::NormalCoordinates(int i) const
+{
+  return normals.Coordinates(i);
+}
+
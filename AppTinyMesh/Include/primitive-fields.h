@@ -0,0 +1,125 @@
+// Signed distance fields of primitives
+
+#pragma once
+
+#include "implicits.h"
+
+class ToreField : public AnalyticScalarField
+{
+protected:
+  double r; //!< Radius of the central circle.
+  double t; //!< Thickness.
+public:
+  explicit ToreField(const Tore&);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
+};
+
+class CylindreField : public AnalyticScalarField
+{
+protected:
+  double r; //!< Radius.
+  double h; //!< Half height.
+public:
+  explicit CylindreField(const Cylindre&);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
+};
+
+class CapsuleField : public AnalyticScalarField
+{
+protected:
+  double r; //!< Radius.
+  double h; //!< Half length of the axis.
+public:
+  explicit CapsuleField(const Capsule&);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
+};
+
+class DiskField : public AnalyticScalarField
+{
+protected:
+  Vector c; //!< Center.
+  double r; //!< Radius.
+  double e; //!< Thickness.
+public:
+  explicit DiskField(const Disk&, double = 0.0);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
+};
+
+class BoxField : public AnalyticScalarField
+{
+protected:
+  Box box; //!< Box.
+public:
+  explicit BoxField(const Box&);
+
+  virtual double Value(const Vector&) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double ValueGradient(const Vector&, Vector&) const;
+  virtual double Lipschitz() const;
+
+  Box GetBox() const;
+};
+
+/*!
+\brief Return the bounding box of the tore.
+*/
+inline Box ToreField::GetBox() const
+{
+  return Box(Vector(-r - t, -r - t, -t), Vector(r + t, r + t, t));
+}
+
+/*!
+\brief Return the bounding box of the cylinder.
+*/
+inline Box CylindreField::GetBox() const
+{
+  return Box(Vector(-r, -h, -r), Vector(r, h, r));
+}
+
+/*!
+\brief Return the bounding box of the capsule.
+*/
+inline Box CapsuleField::GetBox() const
+{
+  return Box(Vector(-r, -h - r, -r), Vector(r, h + r, r));
+}
+
+/*!
+\brief Return the bounding box of the disk, including its thickness.
+*/
+inline Box DiskField::GetBox() const
+{
+  return Box(c - Vector(r + e, e, r + e), c + Vector(r + e, e, r + e));
+}
+
+/*!
+\brief Return the box.
+*/
+inline Box BoxField::GetBox() const
+{
+  return box;
+}
@@ -9,6 +9,9 @@ QT_BEGIN_NAMESPACE
 	namespace Ui { class Assets; }
 QT_END_NAMESPACE
 
+class AnalyticScalarField;
+class MeshBVH;
+
 class MainWindow : public QMainWindow
 {
   Q_OBJECT
@@ -17,12 +20,14 @@ private:
 
   MeshWidget* meshWidget;   //!< Viewer
   MeshColor meshColor;		//!< Mesh.
+  AnalyticScalarField* implicit; //!< Implicit surface of the mesh, if any, used for picking.
+  MeshBVH* bvh;                  //!< Hierarchy of the mesh used for picking, built on the first pick.
 
 public:
   MainWindow();
   ~MainWindow();
   void CreateActions();
-  void UpdateGeometry();
+  void UpdateGeometry(AnalyticScalarField* = nullptr);
 
 public slots:
   void editingSceneLeft(const Ray&);
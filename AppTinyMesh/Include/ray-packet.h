@@ -0,0 +1,55 @@
+// Packet ray triangle intersection kernels
+
+#pragma once
+
+#include "mesh.h"
+
+#include <limits>
+
+class WatertightRay
+{
+public:
+  float o[3];         //!< Origin.
+  int kx, ky, kz;     //!< Permutation of the axes, kz is the dominant axis of the direction.
+  float sx, sy, sz;   //!< Shear and scale constants.
+public:
+  explicit WatertightRay(const Ray&);
+};
+
+template<int N>
+class TrianglePacket
+{
+public:
+  float p[3][3][N];   //!< Coordinates of the vertices, indexed by vertex, axis and lane.
+  int count;          //!< Number of triangles.
+public:
+  TrianglePacket();
+
+  void Set(int, const Triangle&);
+  void Set(int, const Vector&, const Vector&, const Vector&);
+
+  int Intersect(const WatertightRay&, float&, float&, float&, float = std::numeric_limits<float>::infinity()) const;
+  bool Occluded(const WatertightRay&, float = std::numeric_limits<float>::infinity()) const;
+};
+
+template<int N>
+class RayPacket
+{
+public:
+  float o[3][N];      //!< Origins, indexed by axis and lane.
+  float s[3][N];      //!< Shear and scale constants.
+  int k[3][2][N];     //!< Masks selecting the permuted axes, indexed by permuted axis, axis 1 or 2, and lane.
+  int count;          //!< Number of rays.
+public:
+  RayPacket();
+
+  void Set(int, const Ray&);
+
+  int Intersect(const Triangle&, float*, float*, float*) const;
+  int Intersect(const Vector&, const Vector&, const Vector&, float*, float*, float*) const;
+};
+
+typedef TrianglePacket<4> TrianglePacket4;
+typedef TrianglePacket<8> TrianglePacket8;
+typedef RayPacket<4> RayPacket4;
+typedef RayPacket<8> RayPacket8;
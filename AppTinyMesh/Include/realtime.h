@@ -9,6 +9,7 @@
 #include "meshcolor.h"
 
 #include <QtCore/QMap>
+#include <QtCore/QStringList>
 
 // Utility class for profiling CPU & GPU
 typedef std::chrono::time_point<std::chrono::high_resolution_clock> MyChrono;
@@ -140,6 +141,7 @@ protected:
 
   // Profiling
   RenderingProfiler profiler;
+  QStringList statistics;       //!< Additional lines of the stats panel.
 
 public:
   MeshWidget();
@@ -161,6 +163,7 @@ public:
   void SetNearAndFarPlane(double, double);
   void SaveScreen(int = 1280, int = 1280);
   QPoint GetMousePosition() const;
+  void SetStatistics(const QStringList&);
 
   void SetMaterial(const QString&, MeshMaterial);
   void SetMaterialGlobal(MeshMaterial);
@@ -0,0 +1,94 @@
+// Scalar grid
+
+#pragma once
+
+#include "implicits.h"
+
+class ScalarGrid : public AnalyticScalarField
+{
+public:
+  //! Surface extraction method.
+  enum Extraction
+  {
+    MarchingCubes,  //!< Marching cubes, one vertex per straddling edge.
+    SurfaceNets,    //!< Naive surface nets, one vertex per straddling cell at the centroid of the edge crossings.
+    DualContouring  //!< Dual contouring, one vertex per straddling cell minimizing the quadratic error to the tangent planes at the edge crossings.
+  };
+protected:
+  Box box;                   //!< Sampled region.
+  int nx, ny, nz;            //!< Number of grid nodes along each axis.
+  Vector d;                  //!< Diagonal of a cell.
+  std::vector<double> field; //!< Sampled values, x varies the fastest.
+  double k;                  //!< Lipschitz bound of the trilinear interpolation.
+public:
+  explicit ScalarGrid(const AnalyticScalarField&, const Box&, int, int = 1);
+  explicit ScalarGrid(const AnalyticScalarField&, const Box&, int, int, int, int = 1);
+
+  virtual double Value(const Vector&) const;
+  virtual double Lipschitz() const;
+
+  double Value(int, int, int) const;
+  Vector Vertex(int, int, int) const;
+  Vector Gradient(int, int, int) const;
+  using AnalyticScalarField::Gradient;
+
+  Box GetBox() const;
+  int Size(int) const;
+
+  void Extract(Mesh&, double = 0.0, int = 1) const;
+  void Extract(Mesh&, const Box&, double = 0.0, int = 1) const;
+  void Extract(Mesh&, Extraction, double = 0.0, const AnalyticScalarField* = nullptr) const;
+
+  void Sample(const AnalyticScalarField&, int, int, int, int, int, int, int = 1);
+protected:
+  void Extract(Mesh&, int, int, int, int, int, int, double, int) const;
+  void ExtractDual(Mesh&, Extraction, double, const AnalyticScalarField*) const;
+  static Vector SolveQef(const double*, const Vector&);
+  size_t Index(int, int, int) const;
+};
+
+/*!
+\brief Return the index of a grid node in the array of values.
+
+The index is computed with size_t, so that grids may have more than 2<sup>31</sup> nodes.
+\param i,j,k Integer coordinates.
+*/
+inline size_t ScalarGrid::Index(int i, int j, int k) const
+{
+  return (size_t(k) * ny + j) * nx + i;
+}
+
+/*!
+\brief Return the sampled value at a grid node.
+\param i,j,k Integer coordinates.
+*/
+inline double ScalarGrid::Value(int i, int j, int k) const
+{
+  return field[Index(i, j, k)];
+}
+
+/*!
+\brief Return the position of a grid node.
+\param i,j,k Integer coordinates.
+*/
+inline Vector ScalarGrid::Vertex(int i, int j, int k) const
+{
+  return box[0] + Vector(i * d[0], j * d[1], k * d[2]);
+}
+
+/*!
+\brief Return the sampled region.
+*/
+inline Box ScalarGrid::GetBox() const
+{
+  return box;
+}
+
+/*!
+\brief Return the number of grid nodes along an axis.
+\param a Axis.
+*/
+inline int ScalarGrid::Size(int a) const
+{
+  return a == 0 ? nx : (a == 1 ? ny : nz);
+}
@@ -0,0 +1,119 @@
+// Array of vertices with selectable precision
+
+#pragma once
+
+#include "box.h"
+
+#include <vector>
+
+class Matrix;
+
+class VertexArray
+{
+public:
+  //! Storage of the coordinates.
+  enum Precision
+  {
+    Double = 0, //!< Array of vectors in double precision.
+    Float = 1,  //!< Three arrays of coordinates in single precision.
+  };
+protected:
+  Precision precision;          //!< Storage.
+  std::vector<Vector> v;        //!< Vertices in double precision.
+  std::vector<float> x, y, z;   //!< Coordinates in single precision.
+public:
+  explicit VertexArray(Precision = Double);
+  explicit VertexArray(const std::vector<Vector>&, Precision = Double);
+
+  int size() const;
+  void reserve(int);
+  void resize(int, const Vector& = Vector::Null);
+  void clear();
+  void push_back(const Vector&);
+
+  Vector operator[](int) const;
+  void Set(int, const Vector&);
+
+  void Append(const VertexArray&);
+  void Append(const std::vector<Vector>&);
+
+  Precision GetPrecision() const;
+  void SetPrecision(Precision);
+
+  const float* Coordinates(int) const;
+  long long Memory() const;
+
+  Box GetBox() const;
+
+  void Scale(double);
+  void Scale(const Vector&);
+  void Translate(const Vector&);
+  void Transform(const Matrix&);
+  void Negate();
+};
+
+/*!
+\brief Return the number of vertices.
+*/
+inline int VertexArray::size() const
+{
+  return int((precision == Double) ? v.size() : x.size());
+}
+
+/*!
+\brief Return a vertex.
+\param i Index.
+*/
+inline Vector VertexArray::operator[](int i) const
+{
+  if (precision == Double)
+  {
+    return v[i];
+  }
+  return Vector(x[i], y[i], z[i]);
+}
+
+/*!
+\brief Set a vertex, rounded to the precision of the array.
+\param i Index.
+\param p Vertex.
+*/
+inline void VertexArray::Set(int i, const Vector& p)
+{
+  if (precision == Double)
+  {
+    v[i] = p;
+  }
+  else
+  {
+    x[i] = float(p[0]);
+    y[i] = float(p[1]);
+    z[i] = float(p[2]);
+  }
+}
+
+/*!
+\brief Add a vertex at the end of the array.
+\param p Vertex.
+*/
+inline void VertexArray::push_back(const Vector& p)
+{
+  if (precision == Double)
+  {
+    v.push_back(p);
+  }
+  else
+  {
+    x.push_back(float(p[0]));
+    y.push_back(float(p[1]));
+    z.push_back(float(p[2]));
+  }
+}
+
+/*!
+\brief Return the storage of the coordinates.
+*/
+inline VertexArray::Precision VertexArray::GetPrecision() const
+{
+  return precision;
+}
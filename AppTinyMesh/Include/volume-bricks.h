@@ -0,0 +1,130 @@
+// Bricked multi-resolution volume
+
+#pragma once
+
+#include "volume-field.h"
+
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+
+class BrickedVolumeField : public AnalyticScalarField
+{
+protected:
+  //! Level of the hierarchy of resolutions.
+  struct Level
+  {
+    int nx, ny, nz;           //!< Number of samples along each axis.
+    int bx, by, bz;           //!< Number of bricks along each axis.
+    Vector d;                 //!< Distance between samples.
+    long long first;          //!< Global index of the first brick of the level.
+    std::vector<float> range; //!< Minimum and maximum sample of every brick, x varies the fastest.
+  };
+  //! Brick in memory.
+  typedef std::shared_ptr<const std::vector<float> > Brick;
+  struct Sparse;
+  //! Entry of the cache.
+  struct Page
+  {
+    Brick brick;                           //!< Samples.
+    std::list<long long>::iterator recent; //!< Position in the list of recently used bricks.
+  };
+protected:
+  Box box;                   //!< Region covered by the finest level.
+  int brick;                 //!< Number of cells of a brick along every axis, bricks store one more sample to share their faces.
+  std::vector<Level> levels; //!< Levels, from the finest to the coarsest.
+  int level;                 //!< Level used for evaluating the field.
+  double iso;                //!< Iso-value.
+
+  // Cache
+  mutable std::ifstream file;                        //!< Brick file.
+  long long data;                                    //!< Position of the first brick in the file, in bytes.
+  mutable std::mutex mutex;                          //!< Lock protecting the file and the cache.
+  mutable std::unordered_map<long long, Page> pages; //!< Bricks in memory, indexed by their global index.
+  mutable std::list<long long> recent;               //!< Bricks in memory, from the most to the least recently used.
+  size_t capacity;                                   //!< Maximum number of bricks in memory.
+  mutable long long loads;                           //!< Number of bricks read from the file.
+public:
+  explicit BrickedVolumeField(const std::string&, double = 0.0, size_t = size_t(256) << 20);
+  BrickedVolumeField(const BrickedVolumeField&) = delete;
+  BrickedVolumeField& operator=(const BrickedVolumeField&) = delete;
+
+  static bool Create(const VolumeScalarField&, const std::string&, int = 32, int = 0);
+
+  bool IsOpen() const;
+
+  virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double Lipschitz() const;
+
+  int Levels() const;
+  void SetLevel(int);
+  int GetLevel() const;
+  int Select(double) const;
+  int Size(int) const;
+  Box GetBox() const;
+  bool Straddle(int, int, int) const;
+  long long Loads() const;
+
+  void SetIso(double);
+  double GetIso() const;
+
+  void Polygonize(Mesh&, int = 1, const double& = 1e-4) const;
+  using AnalyticScalarField::Polygonize;
+protected:
+  Brick Fetch(int, int) const;
+  int Locate(const Level&, const Vector&, Vector&) const;
+  double Interpolate(const std::vector<float>&, const Vector&) const;
+  void Region(int, const int*, const int*, std::vector<float>&) const;
+  static void Layout(const Box&, int, int, int, int, int, std::vector<Level>&);
+};
+
+/*!
+\brief Return the number of levels.
+*/
+inline int BrickedVolumeField::Levels() const
+{
+  return int(levels.size());
+}
+
+/*!
+\brief Return the level used for evaluating the field.
+*/
+inline int BrickedVolumeField::GetLevel() const
+{
+  return level;
+}
+
+/*!
+\brief Return the number of samples of the current level along an axis, 0 if the volume is not open.
+\param a Axis.
+*/
+inline int BrickedVolumeField::Size(int a) const
+{
+  if (!IsOpen())
+  {
+    return 0;
+  }
+  const Level& l = levels[level];
+  return a == 0 ? l.nx : (a == 1 ? l.ny : l.nz);
+}
+
+/*!
+\brief Return the region covered by the volume.
+*/
+inline Box BrickedVolumeField::GetBox() const
+{
+  return box;
+}
+
+/*!
+\brief Return the number of bricks read from the file since the volume was opened.
+
+Bricks that are found in the cache are not counted.
+*/
+inline long long BrickedVolumeField::Loads() const
+{
+  return loads;
+}
@@ -0,0 +1,104 @@
+// Volume scalar field
+
+#pragma once
+
+#include "implicits.h"
+
+#include <string>
+
+class VolumeScalarField : public AnalyticScalarField
+{
+public:
+  //! Type of the voxels of a raw volume.
+  enum Format
+  {
+    UInt8,   //!< Unsigned 8-bit integers.
+    UInt16,  //!< Unsigned 16-bit integers, in the byte order of the machine.
+    Float32  //!< 32-bit floating point values, in the byte order of the machine.
+  };
+protected:
+  Box box;                         //!< Region covered by the volume, voxel centers lie on a regular grid from the lower to the upper vertex.
+  int nx, ny, nz;                  //!< Number of voxels along each axis.
+  Vector d;                        //!< Distance between voxel centers.
+  Format format;                   //!< Type of the voxels.
+  double iso;                      //!< Iso-value.
+  const unsigned char* data;       //!< Mapped voxels, x varies the fastest.
+  const unsigned char* mapping;    //!< Start of the mapping, before the header of the file.
+  size_t length;                   //!< Length of the mapping.
+#ifdef _WIN32
+  void* file;                      //!< File handle.
+  void* view;                      //!< File mapping handle.
+#endif
+  mutable double k;                //!< Lipschitz constant, computed on demand.
+public:
+  explicit VolumeScalarField(const std::string&, int, int, int, Format, const Box&, double = 0.0, size_t = 0);
+  VolumeScalarField(const VolumeScalarField&) = delete;
+  VolumeScalarField& operator=(const VolumeScalarField&) = delete;
+  ~VolumeScalarField();
+
+  bool IsOpen() const;
+
+  virtual double Value(const Vector&) const;
+  virtual void Values(const double*, const double*, const double*, double*, int) const;
+  virtual Vector Gradient(const Vector&) const;
+  virtual double Lipschitz() const;
+
+  double Voxel(int, int, int) const;
+  Vector Vertex(int, int, int) const;
+  int Size(int) const;
+  Box GetBox() const;
+
+  void SetIso(double);
+  double GetIso() const;
+
+  void Polygonize(Mesh&, int = 1, const double& = 1e-4) const;
+  using AnalyticScalarField::Polygonize;
+protected:
+  double Trilinear(const Vector&) const;
+};
+
+/*!
+\brief Return the value of a voxel, in the units of the file.
+
+This is the fast path for grid nodes that land exactly on voxels: no interpolation is needed. The volume should be open.
+\param i,j,k Integer coordinates of the voxel.
+*/
+inline double VolumeScalarField::Voxel(int i, int j, int k) const
+{
+  const size_t index = (size_t(k) * ny + j) * nx + i;
+  switch (format)
+  {
+  case UInt8:
+    return data[index];
+  case UInt16:
+    return reinterpret_cast<const unsigned short*>(data)[index];
+  default:
+    return reinterpret_cast<const float*>(data)[index];
+  }
+}
+
+/*!
+\brief Return the position of the center of a voxel.
+\param i,j,k Integer coordinates.
+*/
+inline Vector VolumeScalarField::Vertex(int i, int j, int k) const
+{
+  return box[0] + Vector(i * d[0], j * d[1], k * d[2]);
+}
+
+/*!
+\brief Return the number of voxels along an axis.
+\param a Axis.
+*/
+inline int VolumeScalarField::Size(int a) const
+{
+  return a == 0 ? nx : (a == 1 ? ny : nz);
+}
+
+/*!
+\brief Return the region covered by the volume.
+*/
+inline Box VolumeScalarField::GetBox() const
+{
+  return box;
+}
@@ -0,0 +1,288 @@
+// Skeletal blob field
+
+// Self include
+#include "blob-field.h"
+
+#include <algorithm>
+#include <utility>
+
+/*!
+\class BlobField blob-field.h
+\brief A blob field defined as the sum of many point and segment skeletal primitives with compact support.
+
+The field of a primitive is w (1-d<SUP>2</SUP>/r<SUP>2</SUP>)<SUP>3</SUP> where d is the distance to its skeleton, and vanishes beyond the radius r.
+The field of the blob is the threshold minus the sum of the fields of the primitives, so that it is negative inside:
+
+\code
+std::vector<BlobField::Blob> blobs;
+blobs.push_back(BlobField::Blob(Vector(0.0), 1.0));
+blobs.push_back(BlobField::Blob(Vector(0.0), Vector(2.0, 0.0, 0.0), 0.5));
+BlobField blob(blobs);
+
+Mesh mesh;
+blob.Polygonize(128, mesh, blob.GetBox());
+\endcode
+
+Primitives are stored in the cells of a uniform grid whose cells are about the size of the average support.
+An evaluation only visits the primitives of the cell containing the point, so that its cost does not depend on the number of primitives
+but on their overlap.
+*/
+
+/*!
+\brief Create a point primitive.
+\param c Center.
+\param r Radius.
+\param w Weight.
+*/
+BlobField::Blob::Blob(const Vector& c, double r, double w) :a(c), b(c), r(r), w(w)
+{
+}
+
+/*!
+\brief Create a segment primitive.
+\param a,b End vertices.
+\param r Radius.
+\param w Weight.
+*/
+BlobField::Blob::Blob(const Vector& a, const Vector& b, double r, double w) :a(a), b(b), r(r), w(w)
+{
+}
+
+/*!
+\brief Create a blob field and index its primitives.
+\param blobs Primitives.
+\param t Threshold.
+*/
+BlobField::BlobField(const std::vector<Blob>& blobs, double t) :threshold(t), nx(1), ny(1), nz(1), k(0.0)
+{
+  const int n = int(blobs.size());
+
+  primitives.resize(n);
+  box = Box(Vector::Null, 0.0);
+  double diameter = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    const Blob& blob = blobs[i];
+    Primitive& p = primitives[i];
+    p.a = blob.a;
+    p.ab = blob.b - blob.a;
+    const double l = SquaredNorm(p.ab);
+    p.il = (l > 0.0) ? 1.0 / l : 0.0;
+    p.rr = blob.r * blob.r;
+    p.irr = 1.0 / p.rr;
+    p.w = blob.w;
+
+    const Box support(Box(blob.a, blob.r), Box(blob.b, blob.r));
+    box = (i == 0) ? support : Box(box, support);
+    diameter += 2.0 * blob.r;
+  }
+
+  // Cells about the size of the average support, with a bounded number of cells per primitive
+  const Vector size = box.Size();
+  if (n > 0)
+  {
+    const double c = diameter / n;
+    nx = std::min(std::max(int(ceil(size[0] / c)), 1), 256);
+    ny = std::min(std::max(int(ceil(size[1] / c)), 1), 256);
+    nz = std::min(std::max(int(ceil(size[2] / c)), 1), 256);
+    const double cells = double(nx) * ny * nz;
+    const double limit = 8.0 * n;
+    if (cells > limit)
+    {
+      const double s = cbrt(cells / limit);
+      nx = std::max(int(nx / s), 1);
+      ny = std::max(int(ny / s), 1);
+      nz = std::max(int(nz / s), 1);
+    }
+  }
+  d = Vector(size[0] / nx, size[1] / ny, size[2] / nz);
+  const double half = 0.5 * Norm(d);
+
+  // Pairs of cell and primitive, cells whose center is farther than the support and half the diagonal of a cell are skipped
+  std::vector<std::pair<int, int> > pairs;
+  for (int i = 0; i < n; i++)
+  {
+    const Blob& blob = blobs[i];
+    const Box support(Box(blob.a, blob.r), Box(blob.b, blob.r));
+    int a[3], b[3];
+    const int m[3] = { nx, ny, nz };
+    for (int c = 0; c < 3; c++)
+    {
+      a[c] = std::min(std::max(int(floor((support[0][c] - box[0][c]) / d[c])), 0), m[c] - 1);
+      b[c] = std::min(std::max(int(floor((support[1][c] - box[0][c]) / d[c])), 0), m[c] - 1);
+    }
+    const double reach = (blob.r + half) * (blob.r + half);
+    for (int z = a[2]; z <= b[2]; z++)
+    {
+      for (int y = a[1]; y <= b[1]; y++)
+      {
+        for (int x = a[0]; x <= b[0]; x++)
+        {
+          const Vector center = box[0] + Vector((x + 0.5) * d[0], (y + 0.5) * d[1], (z + 0.5) * d[2]);
+          Vector e;
+          if (Distance(primitives[i], center, e) <= reach)
+          {
+            pairs.push_back(std::make_pair((z * ny + y) * nx + x, i));
+          }
+        }
+      }
+    }
+  }
+
+  // Cell lists in compressed form
+  const int nc = nx * ny * nz;
+  first.assign(nc + 1, 0);
+  for (const std::pair<int, int>& p : pairs)
+  {
+    first[p.first + 1]++;
+  }
+  for (int c = 0; c < nc; c++)
+  {
+    first[c + 1] += first[c];
+  }
+  cells.resize(pairs.size());
+  std::vector<int> fill(first.begin(), first.end() - 1);
+  for (const std::pair<int, int>& p : pairs)
+  {
+    cells[fill[p.first]++] = p.second;
+  }
+
+  // The slope of (1-d^2/r^2)^3 is at most 96/(25 sqrt(5) r), summed over the primitives of every cell
+  const double slope = 96.0 / (25.0 * sqrt(5.0));
+  for (int c = 0; c < nc; c++)
+  {
+    double s = 0.0;
+    for (int j = first[c]; j < first[c + 1]; j++)
+    {
+      const Primitive& p = primitives[cells[j]];
+      s += fabs(p.w) * slope * sqrt(p.irr);
+    }
+    k = Math::Max(k, s);
+  }
+}
+
+/*!
+\brief Return the index of the cell containing a point, or -1 outside of the grid.
+\param p Point.
+*/
+int BlobField::Cell(const Vector& p) const
+{
+  if (!box.Inside(p))
+  {
+    return -1;
+  }
+  // Guard against rounding next to the upper faces of the box
+  const int x = std::min(int((p[0] - box[0][0]) / d[0]), nx - 1);
+  const int y = std::min(int((p[1] - box[0][1]) / d[1]), ny - 1);
+  const int z = std::min(int((p[2] - box[0][2]) / d[2]), nz - 1);
+  return (z * ny + y) * nx + x;
+}
+
+/*!
+\brief Compute the squared distance between a point and the skeleton of a primitive.
+\param p Primitive.
+\param q Point.
+\param e Returned vector from the closest point of the skeleton to the point.
+*/
+double BlobField::Distance(const Primitive& p, const Vector& q, Vector& e)
+{
+  e = q - p.a;
+  if (p.il > 0.0)
+  {
+    const double t = Math::Clamp((e * p.ab) * p.il);
+    e -= t * p.ab;
+  }
+  return SquaredNorm(e);
+}
+
+/*!
+\brief Compute the value of the field.
+\param p Point.
+*/
+double BlobField::Value(const Vector& p) const
+{
+  const int c = Cell(p);
+  if (c < 0)
+  {
+    return threshold;
+  }
+
+  double v = threshold;
+  for (int j = first[c]; j < first[c + 1]; j++)
+  {
+    const Primitive& q = primitives[cells[j]];
+    Vector e;
+    const double dd = Distance(q, p, e);
+    if (dd < q.rr)
+    {
+      const double u = 1.0 - dd * q.irr;
+      v -= q.w * u * u * u;
+    }
+  }
+  return v;
+}
+
+/*!
+\brief Compute the value of the field at a set of points.
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void BlobField::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  for (int i = 0; i < n; i++)
+  {
+    v[i] = Value(Vector(x[i], y[i], z[i]));
+  }
+}
+
+/*!
+\brief Compute the analytic gradient of the field.
+\param p Point.
+*/
+Vector BlobField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the value and the analytic gradient of the field.
+\param p Point.
+\param g Returned gradient.
+*/
+double BlobField::ValueGradient(const Vector& p, Vector& g) const
+{
+  g = Vector::Null;
+  const int c = Cell(p);
+  if (c < 0)
+  {
+    return threshold;
+  }
+
+  double v = threshold;
+  for (int j = first[c]; j < first[c + 1]; j++)
+  {
+    const Primitive& q = primitives[cells[j]];
+    Vector e;
+    const double dd = Distance(q, p, e);
+    if (dd < q.rr)
+    {
+      const double u = 1.0 - dd * q.irr;
+      v -= q.w * u * u * u;
+      g += (6.0 * q.w * u * u * q.irr) * e;
+    }
+  }
+  return v;
+}
+
+/*!
+\brief Return a Lipschitz constant of the field.
+
+The bound is the largest sum of the slopes of the primitives overlapping a cell of the grid.
+*/
+double BlobField::Lipschitz() const
+{
+  return k;
+}
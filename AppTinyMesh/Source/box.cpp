@@ -3,6 +3,8 @@
 // Self include
 #include "box.h"
 
+#include "ray.h"
+
 /*!
 \class Box box.h
 \brief An axis aligned box.
@@ -174,3 +176,46 @@ void Box::Scale(double s)
     b = t;
   }
 }
+
+/*!
+\brief Compute the intersection between the box and a ray.
+
+Uses the slab method, the intersection interval may start behind the origin of the ray.
+\param ray The ray.
+\param tmin, tmax Returned parameters of the entry and exit points.
+\return True if the line of the ray intersects the box.
+*/
+bool Box::Intersect(const Ray& ray, double& tmin, double& tmax) const
+{
+  tmin = -1e16;
+  tmax = 1e16;
+
+  const Vector p = ray.Origin();
+  const Vector d = ray.Direction();
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (fabs(d[i]) < epsilon)
+    {
+      // Parallel to the slab
+      if (p[i] < a[i] || p[i] > b[i])
+      {
+        return false;
+      }
+      continue;
+    }
+    double ta = (a[i] - p[i]) / d[i];
+    double tb = (b[i] - p[i]) / d[i];
+    if (ta > tb)
+    {
+      std::swap(ta, tb);
+    }
+    tmin = Math::Max(tmin, ta);
+    tmax = Math::Min(tmax, tb);
+    if (tmin > tmax)
+    {
+      return false;
+    }
+  }
+  return true;
+}
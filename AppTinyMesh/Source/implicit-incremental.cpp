@@ -0,0 +1,366 @@
+// Incremental polygonization
+
+// Self include
+#include "implicit-incremental.h"
+
+#include <algorithm>
+
+/*!
+\class IncrementalPolygonizer implicit-incremental.h
+\brief Polygonization of a field function that is updated locally after an edit.
+
+The field values at grid nodes, the vertex of every straddling edge and the cell of every triangle are kept
+between updates. When a node of an implicit tree is edited, only the grid nodes inside the old and the new bounding boxes
+of the node are sampled again, and only the cells touching those nodes are polygonized again. Their triangles replace
+the previous ones in the mesh, and the vertices on the border of the region are shared with the rest of the mesh,
+therefore the mesh remains crack-free:
+
+\code
+IncrementalPolygonizer polygonizer(tree, 128, Box(2.5));
+Mesh mesh;
+polygonizer.Polygonize(mesh);
+
+Box old = node->GetBox();
+// Edit the node...
+polygonizer.Update(mesh, old, node->GetBox());
+\endcode
+
+The boxes should contain all the points where the sign of the field may change, which is the case of the bounding boxes
+of the nodes of an ImplicitNode tree. The mesh should not be modified between updates.
+
+The triangles of every cell are indexed, and removed vertices and triangles are replaced by the added ones or by the last ones
+of the mesh, so that the cost of an update is proportional to the size of the edited region and not to the size of the mesh.
+The order of the vertices and triangles is therefore not the one of a polygonization from scratch.
+The vertices on the straddling edges of the region are computed in batches with the method set by AnalyticScalarField::SetRootFinder().
+*/
+
+/*!
+\brief Fill the holes of an array with its last elements.
+\param holes Indexes of the holes.
+\param n Size of the array.
+\param move Function called with the index of every moved element and the index of the hole that it fills.
+\return The new size of the array.
+*/
+template<typename Move>
+static int Fill(std::vector<int>& holes, int n, const Move& move)
+{
+  std::sort(holes.begin(), holes.end());
+  int lo = 0, hi = int(holes.size()) - 1;
+  while (lo <= hi)
+  {
+    n--;
+    if (holes[hi] == n)
+    {
+      hi--;
+    }
+    else
+    {
+      move(n, holes[lo++]);
+    }
+  }
+  return n;
+}
+
+/*!
+\brief Sample a field function for incremental polygonization.
+\param f Field function, which should remain valid as long as the polygonizer is used.
+\param n Number of grid nodes along each axis.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\param threads Number of threads used for sampling, use all available cores if null or negative.
+*/
+IncrementalPolygonizer::IncrementalPolygonizer(const AnalyticScalarField& f, int n, const Box& box, const double& epsilon, int threads) :ScalarGrid(f, box, n, threads), source(&f), epsilon(epsilon)
+{
+}
+
+/*!
+\brief Compute the polygonal mesh of the whole grid.
+\param g Returned geometry, with the storage it has on entry.
+*/
+void IncrementalPolygonizer::Polygonize(Mesh& g)
+{
+  g = Mesh(g.GetPrecision());
+  edges.clear();
+  keys.clear();
+  cells.clear();
+  triangles.clear();
+
+  const int a[3] = { 0, 0, 0 };
+  const int b[3] = { nx - 2, ny - 2, nz - 2 };
+  const bool shared[3] = { false, false, false };
+  PolygonizeCells(g, a, b, shared, shared);
+}
+
+/*!
+\brief Update the polygonal mesh after an edit of the field restricted to a region.
+\param g Geometry, previously computed by the polygonizer, which is updated.
+\param old,edited Boxes of the edited region before and after the edit.
+*/
+void IncrementalPolygonizer::Update(Mesh& g, const Box& old, const Box& edited)
+{
+  const Box u(old, edited);
+  const int n[3] = { nx, ny, nz };
+
+  int a[3], b[3];
+  bool low[3], high[3];
+  for (int c = 0; c < 3; c++)
+  {
+    // Grid nodes inside the edited region
+    const int i0 = int(floor((u[0][c] - box[0][c]) / d[c]));
+    const int i1 = int(ceil((u[1][c] - box[0][c]) / d[c]));
+    if (i1 < 0 || i0 > n[c] - 1)
+    {
+      return;
+    }
+
+    // Cells touching those nodes, and whether the faces of the range are shared with unchanged cells
+    a[c] = std::max(i0 - 1, 0);
+    b[c] = std::min(i1, n[c] - 2);
+    low[c] = i0 - 1 >= 0;
+    high[c] = i1 + 1 <= n[c] - 1;
+  }
+
+  Sample(*source, a[0], a[1], a[2], b[0] + 1, b[1] + 1, b[2] + 1);
+  PolygonizeCells(g, a, b, low, high);
+}
+
+/*!
+\brief Polygonize a range of cells and splice the result into the mesh.
+
+The triangles of the cells in the range are replaced. Vertices on the edges lying in a shared face of the range
+are reused, the other ones are computed again.
+\param g Geometry.
+\param a,b Range of cells, included.
+\param low,high Whether the lower and upper faces of the range along every axis are shared with unchanged cells.
+*/
+void IncrementalPolygonizer::PolygonizeCells(Mesh& g, const int* a, const int* b, const bool* low, const bool* high)
+{
+  // Edges in a shared face keep their vertex
+  auto shared = [&](const int* p, int axis)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        if (c != axis && ((low[c] && p[c] == a[c]) || (high[c] && p[c] == b[c] + 1)))
+        {
+          return true;
+        }
+      }
+      return false;
+    };
+
+  // Remove the triangles of the range, and the vertices that are not in a shared face
+  std::vector<int> tholes, vholes;
+  for (int k = a[2]; k <= b[2]; k++)
+  {
+    for (int j = a[1]; j <= b[1]; j++)
+    {
+      for (int i = a[0]; i <= b[0]; i++)
+      {
+        auto it = triangles.find(CellKey(i, j, k));
+        if (it == triangles.end())
+        {
+          continue;
+        }
+        for (int t : it->second)
+        {
+          tholes.push_back(t);
+          for (int c = 0; c < 3; c++)
+          {
+            const int v = g.VertexIndex(t, c);
+            const long long key = keys[v];
+            const int p[3] = { int((key / 3) % nx), int((key / 3 / nx) % ny), int(key / 3 / nx / ny) };
+            if (!shared(p, int(key % 3)) && edges.erase(key) != 0)
+            {
+              vholes.push_back(v);
+            }
+          }
+        }
+        triangles.erase(it);
+      }
+    }
+  }
+
+  // Straddling edges of the added vertices, per axis since the edges along an axis share their length
+  struct Segments
+  {
+    std::vector<Vector> a, b;
+    std::vector<double> va, vb;
+    std::vector<int> vertex;
+  } segments[3];
+  std::vector<long long> vkeys;
+  std::vector<int> triangle;
+  std::vector<long long> tcells;
+  std::unordered_map<long long, int> fresh;
+
+  for (int k = a[2]; k <= b[2]; k++)
+  {
+    for (int j = a[1]; j <= b[1]; j++)
+    {
+      for (int i = a[0]; i <= b[0]; i++)
+      {
+        double v[8];
+        for (int c = 0; c < 8; c++)
+        {
+          v[c] = Value(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1));
+        }
+        const int cubeindex = CubeIndex(v);
+
+        // Cube is not straddling the surface
+        if ((cubeindex == 255) || (cubeindex == 0))
+        {
+          continue;
+        }
+
+        int e[12];
+        for (int h = 0; h < 12; h++)
+        {
+          const int ca = CubeEdge[h][0];
+          const int cb = CubeEdge[h][1];
+          if ((v[ca] < 0.0) == (v[cb] < 0.0))
+          {
+            continue;
+          }
+
+          const int p[3] = { i + (ca & 1), j + ((ca >> 1) & 1), k + ((ca >> 2) & 1) };
+          const int axis = CubeEdge[h][2];
+          const long long key = EdgeKey(p[0], p[1], p[2], axis);
+
+          if (shared(p, axis))
+          {
+            auto it = edges.find(key);
+            if (it != edges.end())
+            {
+              e[h] = it->second;
+              continue;
+            }
+          }
+
+          auto it = fresh.find(key);
+          if (it == fresh.end())
+          {
+            Segments& s = segments[axis];
+            s.a.push_back(Vertex(p[0], p[1], p[2]));
+            s.b.push_back(Vertex(i + (cb & 1), j + ((cb >> 1) & 1), k + ((cb >> 2) & 1)));
+            s.va.push_back(v[ca]);
+            s.vb.push_back(v[cb]);
+            s.vertex.push_back(int(vkeys.size()));
+            vkeys.push_back(key);
+            it = fresh.emplace(key, -int(vkeys.size())).first;
+          }
+          e[h] = it->second;
+        }
+
+        const int nt = CubeTriangles(cubeindex, e, triangle);
+        tcells.insert(tcells.end(), nt, CellKey(i, j, k));
+      }
+    }
+  }
+
+  // Vertices on the straddling edges in batches
+  std::vector<Vector> vertex(vkeys.size());
+  std::vector<Vector> normal(vkeys.size());
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const Segments& s = segments[axis];
+    const int n = int(s.vertex.size());
+    std::vector<Vector> c(n);
+    source->Roots(n, s.a.data(), s.b.data(), s.va.data(), s.vb.data(), d[axis], c.data(), epsilon);
+    for (int h = 0; h < n; h++)
+    {
+      vertex[s.vertex[h]] = c[h];
+      normal[s.vertex[h]] = source->Normal(c[h]);
+    }
+  }
+
+  // Added vertices and triangles fill the holes first, then are appended
+  int nv = g.Vertexes();
+  int nt = g.Triangles();
+  g.Resize(nv + std::max(int(vertex.size()) - int(vholes.size()), 0), nt + std::max(int(tcells.size()) - int(tholes.size()), 0));
+  keys.resize(g.Vertexes());
+  cells.resize(g.Triangles());
+
+  std::vector<int> place(vertex.size());
+  for (int i = 0; i < int(vertex.size()); i++)
+  {
+    place[i] = i < int(vholes.size()) ? vholes[i] : nv++;
+    g.SetVertex(place[i], vertex[i], normal[i]);
+    keys[place[i]] = vkeys[i];
+    edges[vkeys[i]] = place[i];
+  }
+  for (int i = 0; i < int(tcells.size()); i++)
+  {
+    const int t = i < int(tholes.size()) ? tholes[i] : nt++;
+    int v[3];
+    for (int c = 0; c < 3; c++)
+    {
+      v[c] = triangle[3 * i + c] >= 0 ? triangle[3 * i + c] : place[-1 - triangle[3 * i + c]];
+    }
+    g.SetTriangle(t, v[0], v[1], v[2]);
+    cells[t] = tcells[i];
+    triangles[tcells[i]].push_back(t);
+  }
+
+  // Remaining holes are filled with the last triangles and vertices
+  tholes.erase(tholes.begin(), tholes.begin() + std::min(tholes.size(), tcells.size()));
+  nt = Fill(tholes, g.Triangles(), [&](int from, int to)
+    {
+      std::vector<int>& list = triangles[cells[from]];
+      *std::find(list.begin(), list.end(), from) = to;
+      cells[to] = cells[from];
+      g.SetTriangle(to, g.VertexIndex(from, 0), g.VertexIndex(from, 1), g.VertexIndex(from, 2));
+    });
+  cells.resize(nt);
+
+  vholes.erase(vholes.begin(), vholes.begin() + std::min(vholes.size(), vertex.size()));
+  nv = Fill(vholes, g.Vertexes(), [&](int from, int to) { MoveVertex(g, from, to); });
+  keys.resize(nv);
+  g.Resize(nv, nt);
+}
+
+/*!
+\brief Move a vertex of the mesh to another index, and update the triangles referencing it.
+
+The triangles are found among those of the cells sharing the edge of the vertex.
+\param g Geometry.
+\param from,to Indexes.
+*/
+void IncrementalPolygonizer::MoveVertex(Mesh& g, int from, int to)
+{
+  const long long key = keys[from];
+  keys[to] = key;
+  edges[key] = to;
+  g.SetVertex(to, g.Vertex(from), g.Normal(from));
+
+  const int axis = int(key % 3);
+  const int p[3] = { int((key / 3) % nx), int((key / 3 / nx) % ny), int(key / 3 / nx / ny) };
+  const int n[3] = { nx - 1, ny - 1, nz - 1 };
+  const int u = (axis + 1) % 3;
+  const int w = (axis + 2) % 3;
+  for (int o = 0; o < 4; o++)
+  {
+    int c[3] = { p[0], p[1], p[2] };
+    c[u] -= o & 1;
+    c[w] -= o >> 1;
+    if (c[u] < 0 || c[w] < 0 || c[u] >= n[u] || c[w] >= n[w])
+    {
+      continue;
+    }
+    auto it = triangles.find(CellKey(c[0], c[1], c[2]));
+    if (it == triangles.end())
+    {
+      continue;
+    }
+    for (int t : it->second)
+    {
+      int v[3] = { g.VertexIndex(t, 0), g.VertexIndex(t, 1), g.VertexIndex(t, 2) };
+      if (v[0] == from || v[1] == from || v[2] == from)
+      {
+        for (int i = 0; i < 3; i++)
+        {
+          v[i] = (v[i] == from) ? to : v[i];
+        }
+        g.SetTriangle(t, v[0], v[1], v[2]);
+      }
+    }
+  }
+}
@@ -0,0 +1,631 @@
+// Implicit tree
+
+// Self include
+#include "implicit-tree.h"
+
+#include <algorithm>
+
+/*!
+\class ImplicitNode implicit-tree.h
+\brief Base node of a tree of implicit surfaces.
+
+Every node stores the bounding box of the object it represents. The field function of the node should
+be a signed distance bound that is greater than the distance to the box outside of the box, so that
+operators can skip the evaluation of a sub-tree from the distance to its box. This is the case of exact
+signed distance functions and of all the operators of the tree.
+
+Operators only skip the evaluation of a sub-tree outside of its box and when the result is not modified, therefore the field
+of the tree is exact, and the evaluation cost grows with the logarithm of the number of primitives for well separated objects.
+
+\code
+ImplicitNode* a = new ImplicitPrimitive(new SphereField(Vector(-0.5, 0.0, 0.0), 1.0), Box(Vector(-0.5, 0.0, 0.0), 1.0));
+ImplicitNode* b = new ImplicitPrimitive(new SphereField(Vector(0.5, 0.0, 0.0), 1.0), Box(Vector(0.5, 0.0, 0.0), 1.0));
+ImplicitBlend blend(a, b, 0.5);
+
+Mesh mesh;
+blend.Polygonize(64, mesh, Box(2.5));
+\endcode
+*/
+
+/*!
+\brief Create a node.
+\param box Bounding box of the object.
+\param k Lipschitz bound of the field.
+*/
+ImplicitNode::ImplicitNode(const Box& box, double k) :box(box), k(k)
+{
+}
+
+/*!
+\brief Return the Lipschitz bound of the field.
+*/
+double ImplicitNode::Lipschitz() const
+{
+  return k;
+}
+
+/*!
+\brief Recompute the bounding boxes of the sub-tree after an edit of one of its nodes.
+
+Primitives keep their box, operators and transforms recompute their box from their sub-trees.
+*/
+void ImplicitNode::Update()
+{
+}
+
+/*!
+\brief Compute the gradient of the field, from the combined value and gradient of the node.
+\param p Point.
+*/
+Vector ImplicitNode::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\class ImplicitPrimitive implicit-tree.h
+\brief A leaf of the tree, defined by a field function.
+*/
+
+/*!
+\brief Create a primitive from a field function.
+
+The node takes the ownership of the field, and uses its Lipschitz bound.
+\param f Field function, should be greater than the distance to the box outside of the box.
+\param box Bounding box of the object.
+*/
+ImplicitPrimitive::ImplicitPrimitive(const AnalyticScalarField* f, const Box& box) :ImplicitNode(box, f->Lipschitz()), field(f)
+{
+}
+
+/*!
+\brief Destroy the primitive and its field function.
+*/
+ImplicitPrimitive::~ImplicitPrimitive()
+{
+  delete field;
+}
+
+/*!
+\brief Compute the value of the field.
+\param p Point.
+*/
+double ImplicitPrimitive::Value(const Vector& p) const
+{
+  return field->Value(p);
+}
+
+/*!
+\brief Compute the value of the field at a set of points, using the batched evaluation of the field function.
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void ImplicitPrimitive::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  field->Values(x, y, z, v, n);
+}
+
+/*!
+\brief Compute the gradient of the field function.
+\param p Point.
+*/
+Vector ImplicitPrimitive::Gradient(const Vector& p) const
+{
+  return field->Gradient(p);
+}
+
+/*!
+\brief Compute the value and the gradient of the field function.
+
+The gradient is analytic if the field function provides it, and computed with central differences otherwise.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitPrimitive::ValueGradient(const Vector& p, Vector& g) const
+{
+  return field->ValueGradient(p, g);
+}
+
+/*!
+\class ImplicitOperator implicit-tree.h
+\brief Base binary operator node, which owns its sub-trees.
+*/
+
+/*!
+\brief Create a binary operator.
+\param a,b Sub-trees.
+\param box Bounding box of the object.
+*/
+ImplicitOperator::ImplicitOperator(ImplicitNode* a, ImplicitNode* b, const Box& box) :ImplicitNode(box, Math::Max(a->Lipschitz(), b->Lipschitz())), a(a), b(b)
+{
+}
+
+/*!
+\brief Destroy the operator and its sub-trees.
+*/
+ImplicitOperator::~ImplicitOperator()
+{
+  delete a;
+  delete b;
+}
+
+/*!
+\brief Update the sub-trees.
+*/
+void ImplicitOperator::Update()
+{
+  a->Update();
+  b->Update();
+}
+
+/*!
+\brief Create the union of two sub-trees.
+\param a,b Sub-trees.
+*/
+ImplicitUnion::ImplicitUnion(ImplicitNode* a, ImplicitNode* b) :ImplicitOperator(a, b, Box(a->GetBox(), b->GetBox()))
+{
+}
+
+/*!
+\brief Recompute the bounding box after an edit.
+*/
+void ImplicitUnion::Update()
+{
+  ImplicitOperator::Update();
+  box = Box(a->GetBox(), b->GetBox());
+}
+
+/*!
+\brief Compute the value of the field.
+
+The closest sub-tree is evaluated first, the other one is skipped if the point is outside of its box
+and the distance to its box is greater than the first value. Inside the box, the field may be lower than the first value.
+\param p Point.
+*/
+double ImplicitUnion::Value(const Vector& p) const
+{
+  const ImplicitNode* u = a;
+  const ImplicitNode* w = b;
+  double du = u->Bound(p);
+  double dw = w->Bound(p);
+  if (dw < du)
+  {
+    std::swap(u, w);
+    std::swap(du, dw);
+  }
+
+  double v = u->Value(p);
+  if (dw > 0.0 && dw >= v)
+  {
+    return v;
+  }
+  return Math::Min(v, w->Value(p));
+}
+
+/*!
+\brief Compute the value and the gradient of the field, which is the gradient of the closest sub-tree.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitUnion::ValueGradient(const Vector& p, Vector& g) const
+{
+  const ImplicitNode* u = a;
+  const ImplicitNode* w = b;
+  double du = u->Bound(p);
+  double dw = w->Bound(p);
+  if (dw < du)
+  {
+    std::swap(u, w);
+    std::swap(du, dw);
+  }
+
+  double v = u->ValueGradient(p, g);
+  if (dw > 0.0 && dw >= v)
+  {
+    return v;
+  }
+  Vector gw;
+  double vw = w->ValueGradient(p, gw);
+  if (vw < v)
+  {
+    g = gw;
+    return vw;
+  }
+  return v;
+}
+
+/*!
+\brief Create a balanced hierarchy of unions from a set of nodes.
+
+Nodes are recursively split at the median of their centers along the largest axis of their bounding box.
+\param nodes Set of nodes, should not be empty.
+\return The root of the hierarchy.
+*/
+ImplicitNode* ImplicitUnion::Create(std::vector<ImplicitNode*> nodes)
+{
+  if (nodes.size() == 1)
+  {
+    return nodes[0];
+  }
+
+  Box box = nodes[0]->GetBox();
+  for (int i = 1; i < int(nodes.size()); i++)
+  {
+    box = Box(box, nodes[i]->GetBox());
+  }
+  Vector d = box.Diagonal();
+  int axis = (d[0] > d[1]) ? (d[0] > d[2] ? 0 : 2) : (d[1] > d[2] ? 1 : 2);
+
+  const int m = int(nodes.size()) / 2;
+  std::nth_element(nodes.begin(), nodes.begin() + m, nodes.end(), [axis](const ImplicitNode* x, const ImplicitNode* y)
+    {
+      return x->GetBox().Center()[axis] < y->GetBox().Center()[axis];
+    });
+
+  ImplicitNode* a = Create(std::vector<ImplicitNode*>(nodes.begin(), nodes.begin() + m));
+  ImplicitNode* b = Create(std::vector<ImplicitNode*>(nodes.begin() + m, nodes.end()));
+  return new ImplicitUnion(a, b);
+}
+
+/*!
+\brief Create the intersection of two sub-trees.
+
+The box of the smallest sub-tree is used, as the field is greater than the distance to this box.
+\param a,b Sub-trees.
+*/
+ImplicitIntersection::ImplicitIntersection(ImplicitNode* a, ImplicitNode* b) :ImplicitOperator(a, b, a->GetBox().Volume() < b->GetBox().Volume() ? a->GetBox() : b->GetBox())
+{
+}
+
+/*!
+\brief Recompute the bounding box after an edit.
+*/
+void ImplicitIntersection::Update()
+{
+  ImplicitOperator::Update();
+  box = a->GetBox().Volume() < b->GetBox().Volume() ? a->GetBox() : b->GetBox();
+}
+
+/*!
+\brief Compute the value of the field.
+\param p Point.
+*/
+double ImplicitIntersection::Value(const Vector& p) const
+{
+  return Math::Max(a->Value(p), b->Value(p));
+}
+
+/*!
+\brief Compute the value and the gradient of the field.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitIntersection::ValueGradient(const Vector& p, Vector& g) const
+{
+  Vector gb;
+  double va = a->ValueGradient(p, g);
+  double vb = b->ValueGradient(p, gb);
+  if (vb > va)
+  {
+    g = gb;
+    return vb;
+  }
+  return va;
+}
+
+/*!
+\brief Create the difference between two sub-trees.
+\param a,b Sub-trees, b is removed from a.
+*/
+ImplicitDifference::ImplicitDifference(ImplicitNode* a, ImplicitNode* b) :ImplicitOperator(a, b, a->GetBox())
+{
+}
+
+/*!
+\brief Recompute the bounding box after an edit.
+*/
+void ImplicitDifference::Update()
+{
+  ImplicitOperator::Update();
+  box = a->GetBox();
+}
+
+/*!
+\brief Compute the value of the field.
+
+The removed sub-tree is skipped if the point is outside of its box and the distance to its box is greater than
+the opposite of the first value, which is always the case outside of both the first object and the box of the removed one.
+\param p Point.
+*/
+double ImplicitDifference::Value(const Vector& p) const
+{
+  double v = a->Value(p);
+  const double db = b->Bound(p);
+  if (db > 0.0 && db >= -v)
+  {
+    return v;
+  }
+  return Math::Max(v, -b->Value(p));
+}
+
+/*!
+\brief Compute the value and the gradient of the field.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitDifference::ValueGradient(const Vector& p, Vector& g) const
+{
+  double v = a->ValueGradient(p, g);
+  const double db = b->Bound(p);
+  if (db > 0.0 && db >= -v)
+  {
+    return v;
+  }
+  Vector gb;
+  double vb = b->ValueGradient(p, gb);
+  if (-vb > v)
+  {
+    g = -gb;
+    return -vb;
+  }
+  return v;
+}
+
+/*!
+\brief Create the smooth union of two sub-trees.
+
+The polynomial smooth minimum lowers the field by at most a quarter of the blending radius,
+therefore the bounding box is enlarged accordingly.
+\param a,b Sub-trees.
+\param r Blending radius.
+*/
+ImplicitBlend::ImplicitBlend(ImplicitNode* a, ImplicitNode* b, double r) :ImplicitOperator(a, b, Box(Box(a->GetBox(), b->GetBox())[0] - Vector(0.25 * r), Box(a->GetBox(), b->GetBox())[1] + Vector(0.25 * r))), r(r)
+{
+}
+
+/*!
+\brief Recompute the bounding box after an edit.
+*/
+void ImplicitBlend::Update()
+{
+  ImplicitOperator::Update();
+  Box ab(a->GetBox(), b->GetBox());
+  box = Box(ab[0] - Vector(0.25 * r), ab[1] + Vector(0.25 * r));
+}
+
+/*!
+\brief Compute the value of the field.
+
+The second sub-tree is skipped if the point is outside of its box and the distance to its box is greater than
+the first value plus the blending radius, as there is no blending in that case.
+\param p Point.
+*/
+double ImplicitBlend::Value(const Vector& p) const
+{
+  const ImplicitNode* u = a;
+  const ImplicitNode* w = b;
+  double du = u->Bound(p);
+  double dw = w->Bound(p);
+  if (dw < du)
+  {
+    std::swap(u, w);
+    std::swap(du, dw);
+  }
+
+  double va = u->Value(p);
+  if (dw > 0.0 && dw >= va + r)
+  {
+    return va;
+  }
+  double vb = w->Value(p);
+
+  double h = Math::Max(r - fabs(va - vb), 0.0) / r;
+  return Math::Min(va, vb) - h * h * r * 0.25;
+}
+
+/*!
+\brief Compute the value and the gradient of the field.
+
+The gradient is the combination of the gradients of the sub-trees weighted by the derivatives of the smooth minimum.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitBlend::ValueGradient(const Vector& p, Vector& g) const
+{
+  const ImplicitNode* u = a;
+  const ImplicitNode* w = b;
+  double du = u->Bound(p);
+  double dw = w->Bound(p);
+  if (dw < du)
+  {
+    std::swap(u, w);
+    std::swap(du, dw);
+  }
+
+  double va = u->ValueGradient(p, g);
+  if (dw > 0.0 && dw >= va + r)
+  {
+    return va;
+  }
+  Vector gb;
+  double vb = w->ValueGradient(p, gb);
+
+  double h = Math::Max(r - fabs(va - vb), 0.0) / r;
+  double t = va < vb ? 1.0 - 0.5 * h : 0.5 * h;
+  g = t * g + (1.0 - t) * gb;
+  return Math::Min(va, vb) - h * h * r * 0.25;
+}
+
+/*!
+\class ImplicitTransform implicit-tree.h
+\brief An affine transform of a sub-tree.
+
+The field of the sub-tree is evaluated at the transformed point and scaled by the norm of the linear part, so that it
+remains greater than the distance to the transformed box. The field is exact for rigid transforms and uniform scalings,
+and the Lipschitz bound is scaled by the condition number of the linear part otherwise.
+*/
+
+/*!
+\brief Create an affine transform.
+\param e Sub-tree.
+\param r0,r1,r2 Rows of the linear part, which should be invertible.
+\param t Translation.
+*/
+ImplicitTransform::ImplicitTransform(ImplicitNode* e, const Vector& r0, const Vector& r1, const Vector& r2, const Vector& t) :ImplicitNode(Box(0.0)), e(e), t(t)
+{
+  r[0] = r0;
+  r[1] = r1;
+  r[2] = r2;
+
+  // Inverse from the cofactors
+  Vector c[3] = { r1 / r2, r2 / r0, r0 / r1 };
+  double det = r0 * c[0];
+  for (int i = 0; i < 3; i++)
+  {
+    ri[i] = Vector(c[0][i], c[1][i], c[2][i]) / det;
+  }
+
+  // Eigenvalues of the symmetric matrix transpose(A) A
+  double m[3][3];
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      m[i][j] = r[0][i] * r[0][j] + r[1][i] * r[1][j] + r[2][i] * r[2][j];
+    }
+  }
+  double lmax, lmin;
+  double p1 = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+  double q = (m[0][0] + m[1][1] + m[2][2]) / 3.0;
+  double p2 = (m[0][0] - q) * (m[0][0] - q) + (m[1][1] - q) * (m[1][1] - q) + (m[2][2] - q) * (m[2][2] - q) + 2.0 * p1;
+  double p = sqrt(p2 / 6.0);
+  if (p < 1e-12 * q)
+  {
+    lmax = lmin = q;
+  }
+  else
+  {
+    double b[3][3];
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        b[i][j] = (m[i][j] - (i == j ? q : 0.0)) / p;
+      }
+    }
+    double det2 = b[0][0] * (b[1][1] * b[2][2] - b[1][2] * b[2][1]) - b[0][1] * (b[1][0] * b[2][2] - b[1][2] * b[2][0]) + b[0][2] * (b[1][0] * b[2][1] - b[1][1] * b[2][0]);
+    double phi = acos(Math::Clamp(0.5 * det2, -1.0, 1.0)) / 3.0;
+    lmax = q + 2.0 * p * cos(phi);
+    lmin = q + 2.0 * p * cos(phi + 2.0 * 3.14159265358979323846 / 3.0);
+  }
+
+  s = sqrt(lmax);
+  k = e->Lipschitz() * s / sqrt(Math::Max(lmin, 0.0));
+
+  Update();
+}
+
+/*!
+\brief Destroy the transform and its sub-tree.
+*/
+ImplicitTransform::~ImplicitTransform()
+{
+  delete e;
+}
+
+/*!
+\brief Recompute the bounding box after an edit, as the bounding box of the transformed box of the sub-tree.
+*/
+void ImplicitTransform::Update()
+{
+  e->Update();
+
+  Box eb = e->GetBox();
+  Vector a = eb.Vertex(0);
+  Vector v = t + Vector(r[0] * a, r[1] * a, r[2] * a);
+  box = Box(v, v);
+  for (int i = 1; i < 8; i++)
+  {
+    a = eb.Vertex(i);
+    v = t + Vector(r[0] * a, r[1] * a, r[2] * a);
+    box = Box(Vector::Min(box[0], v), Vector::Max(box[1], v));
+  }
+}
+
+/*!
+\brief Set the translation of the transform.
+
+The bounding boxes of the nodes above the transform should be updated with ImplicitNode::Update().
+\param v Translation.
+*/
+void ImplicitTransform::SetTranslation(const Vector& v)
+{
+  t = v;
+  Update();
+}
+
+/*!
+\brief Compute the value of the field.
+\param p Point.
+*/
+double ImplicitTransform::Value(const Vector& p) const
+{
+  return s * e->Value(Local(p));
+}
+
+/*!
+\brief Compute the value and the gradient of the field.
+
+The gradient of the sub-tree is transformed by the transpose of the inverse of the linear part.
+\param p Point.
+\param g Returned gradient.
+*/
+double ImplicitTransform::ValueGradient(const Vector& p, Vector& g) const
+{
+  Vector ge;
+  double v = e->ValueGradient(Local(p), ge);
+  g = s * (ge[0] * ri[0] + ge[1] * ri[1] + ge[2] * ri[2]);
+  return s * v;
+}
+
+/*!
+\brief Create a translation.
+\param e Sub-tree.
+\param t Translation vector.
+*/
+ImplicitTransform* ImplicitTransform::Translation(ImplicitNode* e, const Vector& t)
+{
+  return new ImplicitTransform(e, Vector::X, Vector::Y, Vector::Z, t);
+}
+
+/*!
+\brief Create a rotation around an axis through the origin.
+\param e Sub-tree.
+\param axis Rotation axis, should be unit.
+\param a Angle, in radians.
+*/
+ImplicitTransform* ImplicitTransform::Rotation(ImplicitNode* e, const Vector& axis, double a)
+{
+  const double c = cos(a);
+  const double s = sin(a);
+  const double x = axis[0];
+  const double y = axis[1];
+  const double z = axis[2];
+  return new ImplicitTransform(e,
+    Vector(c + x * x * (1.0 - c), x * y * (1.0 - c) - z * s, x * z * (1.0 - c) + y * s),
+    Vector(y * x * (1.0 - c) + z * s, c + y * y * (1.0 - c), y * z * (1.0 - c) - x * s),
+    Vector(z * x * (1.0 - c) - y * s, z * y * (1.0 - c) + x * s, c + z * z * (1.0 - c)));
+}
+
+/*!
+\brief Create a scaling.
+\param e Sub-tree.
+\param s Scaling factors along every axis, should not be null.
+*/
+ImplicitTransform* ImplicitTransform::Scaling(ImplicitNode* e, const Vector& s)
+{
+  return new ImplicitTransform(e, Vector(s[0], 0.0, 0.0), Vector(0.0, s[1], 0.0), Vector(0.0, 0.0, s[2]));
+}
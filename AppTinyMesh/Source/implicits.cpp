@@ -1,4 +1,20 @@
 #include "implicits.h"
+#include "camera.h"
+#include "color.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 const double AnalyticScalarField::Epsilon = 1e-6;
 
@@ -18,227 +34,878 @@ double AnalyticScalarField::Value(const Vector& p) const
   return Norm(p) - 1.0;
 }
 
+/*!
+\brief Compute a Lipschitz bound of the field, i.e. a bound on the norm of its gradient.
+
+Derived classes should override this function, the bound is used for empty space skipping.
+The default field is the signed distance to the unit sphere, therefore the bound is 1.
+*/
+double AnalyticScalarField::Lipschitz() const
+{
+  return 1.0;
+}
+
 /*!
 \brief Compute the polygonal mesh approximating the implicit surface.
 
 \param box %Box defining the region that will be polygonized.
 \param n Discretization parameter.
-\param g Returned geometry.
+\param g Returned geometry, with the storage it has on entry.
 \param epsilon Epsilon value for computing vertices on straddling edges.
+
+The vertices on straddling edges are computed with the method set by AnalyticScalarField::SetRootFinder(),
+and the number of field evaluations is available with AnalyticScalarField::GetEvaluations().
+The mesh is built with the storage of g, so that a mesh created with VertexArray::Float never holds the surface in double precision.
 */
 void AnalyticScalarField::Polygonize(int n, Mesh& g, const Box& box, const double& epsilon) const
 {
-  std::vector<Vector> vertex;
-  std::vector<Vector> normal;
+  Polygonize(n, n, n, g, box, epsilon);
+}
 
-  std::vector<int> triangle;
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface on a grid with a resolution per axis.
+\param nx,ny,nz Number of grid nodes along each axis, at least 2.
+\param g Returned geometry, with the storage it has on entry.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::Polygonize(int nx, int ny, int nz, Mesh& g, const Box& box, const double& epsilon) const
+{
+#ifdef TINYMESH_STATISTICS
+  Statistics stats;
+  Polygonize(*this, nx, ny, nz, g, box, epsilon, finder, iterations, &evaluations, &stats);
+  statistics = stats;
+#else
+  Polygonize(*this, nx, ny, nz, g, box, epsilon, finder, iterations, &evaluations);
+#endif
+}
 
-  vertex.reserve(20000);
-  normal.reserve(20000);
-  triangle.reserve(20000);
+/*!
+\brief Compute the polygonal meshes approximating several iso-surfaces, sampling the field only once.
+
+This is useful for nested offset surfaces: the cost of the classification of the grid is shared by all the levels.
+\param n Discretization parameter.
+\param levels Iso-values.
+\param g Returned geometry, one mesh per iso-value, with the storage of its first mesh on entry.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::Polygonize(int n, const std::vector<double>& levels, std::vector<Mesh>& g, const Box& box, const double& epsilon) const
+{
+  Polygonize(n, n, n, levels, g, box, epsilon);
+}
+
+/*!
+\brief Compute the polygonal meshes approximating several iso-surfaces on a grid with a resolution per axis, sampling the field only once.
+\param nx,ny,nz Number of grid nodes along each axis, at least 2.
+\param levels Iso-values.
+\param g Returned geometry, one mesh per iso-value, with the storage of its first mesh on entry.
+\param box %Box defining the region that will be polygonized.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::Polygonize(int nx, int ny, int nz, const std::vector<double>& levels, std::vector<Mesh>& g, const Box& box, const double& epsilon) const
+{
+#ifdef TINYMESH_STATISTICS
+  Statistics stats;
+  PolygonizeLevels(*this, nx, ny, nz, levels, g, box, epsilon, finder, iterations, &evaluations, &stats);
+  statistics = stats;
+#else
+  PolygonizeLevels(*this, nx, ny, nz, levels, g, box, epsilon, finder, iterations, &evaluations);
+#endif
+}
+
+/*!
+\brief Compute the resolution of the grid along each axis for a target cell size.
+
+Cells are as close as possible to cubes: the number of cells along an axis is the length of the box divided by the size, rounded up.
+\param box %Box.
+\param size Target size of the cells.
+\param nx,ny,nz Returned number of grid nodes along each axis.
+*/
+void AnalyticScalarField::Resolution(const Box& box, const double& size, int& nx, int& ny, int& nz)
+{
+  const Vector diagonal = box.Diagonal();
+  int n[3];
+  for (int i = 0; i < 3; i++)
+  {
+    n[i] = std::max(int(ceil(diagonal[i] / size)), 1) + 1;
+  }
+  nx = n[0];
+  ny = n[1];
+  nz = n[2];
+}
+
+/*!
+\brief Estimate the peak memory of a polygonization, in bytes.
+
+The working set holds two planes of samples, vertices and edges, and the straddling edges of a plane. The output is estimated
+for a surface as large as the faces of the box, and counted twice, because the arrays are copied into the mesh.
+\param nx,ny,nz Number of grid nodes along each axis.
+*/
+long long AnalyticScalarField::PolygonizeMemory(int nx, int ny, int nz)
+{
+  const long long size = (long long)(nx) * ny;
+
+  // Two planes of values, nodes and edge indexes, plus the batch of straddling edges
+  const long long plane = size * (2 * sizeof(double) + 2 * sizeof(Vector) + 5 * sizeof(int)) + size * (3 * sizeof(Vector) + 2 * sizeof(double) + sizeof(int));
+
+  // Vertices, normals and two triangle arrays of six indexes per vertex
+  const long long nv = PolygonizeVertexes(nx, ny, nz);
+  const long long mesh = nv * (2 * sizeof(Vector) + 12 * sizeof(int));
+
+  return plane + 2 * mesh;
+}
+
+/*!
+\brief Set the method for computing the vertices on straddling edges.
+
+Bisection is the most robust, Linear does not evaluate the field, Secant and Illinois converge
+in a few evaluations on smooth fields, and Newton uses AnalyticScalarField::ValueGradient(), which
+is only efficient for fields with an analytic gradient.
+\param f Method.
+\param n Maximum number of iterations.
+*/
+void AnalyticScalarField::SetRootFinder(RootFinder f, int n)
+{
+  finder = f;
+  iterations = n;
+}
+
+/*!
+\brief Return the method for computing the vertices on straddling edges.
+*/
+AnalyticScalarField::RootFinder AnalyticScalarField::GetRootFinder() const
+{
+  return finder;
+}
+
+/*!
+\brief Compute the intersection between a set of segments of the same length and an implicit surface, with the method set by AnalyticScalarField::SetRootFinder().
+
+\param n Number of segments.
+\param a,b End vertices of the segments straddling the surface.
+\param va,vb Field function value at those end vertices.
+\param length Distance between vertices.
+\param c Returned points on the implicit surface.
+\param epsilon Precision.
+*/
+void AnalyticScalarField::Roots(int n, const Vector* a, const Vector* b, const double* va, const double* vb, double length, Vector* c, const double& epsilon) const
+{
+  Roots(*this, finder, iterations, n, a, b, va, vb, length, c, epsilon);
+}
+
+/*!
+\brief Return the number of field evaluations per phase of the last polygonization.
+
+Normals are counted as gradient queries: a gradient computed with central differences costs six evaluations.
+
+The counters are stored in the field, therefore the member polygonization functions should not be called
+on the same field from several threads at the same time. Concurrent polygonizations should use the static
+AnalyticScalarField::Polygonize() templates, which return the counters through their out-parameter.
+*/
+const AnalyticScalarField::Evaluations& AnalyticScalarField::GetEvaluations() const
+{
+  return evaluations;
+}
+
+#ifdef TINYMESH_STATISTICS
+/*!
+\brief Return the instrumentation of the last polygonization.
+
+The statistics are collected by all the member polygonizations, including the multi-level and the octree ones,
+and only exist if the code is compiled with TINYMESH_STATISTICS defined.
+*/
+const AnalyticScalarField::Statistics& AnalyticScalarField::GetStatistics() const
+{
+  return statistics;
+}
+#endif
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface using several threads.
+
+The grid is split into z-slabs that are polygonized independently. Every slab owns the straddling
+edges of its layers except the bottom plane, which is owned by the slab below: the triangles referencing
+those edges are stitched afterwards, so that the resulting mesh is exactly the one produced by
+AnalyticScalarField::Polygonize(), with the same vertex and triangle ordering.
+
+\param n Discretization parameter.
+\param g Returned geometry, with the storage it has on entry.
+\param box %Box defining the region that will be polygonized.
+\param threads Number of threads, use all available cores if null or negative.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::PolygonizeParallel(int n, Mesh& g, const Box& box, int threads, const double& epsilon) const
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  threads = 1;
+#endif
 
-  int nv = 0;
   const int nx = n;
   const int ny = n;
   const int nz = n;
 
-  Box clipped = box;
+  // Several slabs per thread for load balancing, with a minimum thickness because the bottom plane of every slab is sampled twice
+  int slabs = std::max(1, std::min(4 * threads, (nz - 1) / 8));
 
-  // Clamped integer values
-  const int nax = 0;
-  const int nbx = nx;
-  const int nay = 0;
-  const int nby = ny;
-  const int naz = 0;
-  const int nbz = nz;
+  Vector d = box.Diagonal() / (n - 1);
 
-  const int size = nx * ny;
+  const VertexArray::Precision precision = g.GetPrecision();
+  std::vector<VertexArray> vertex(slabs, VertexArray(precision));
+  std::vector<VertexArray> normal(slabs, VertexArray(precision));
+  std::vector<std::vector<int> > triangle(slabs);
+  std::vector<std::vector<int> > top(slabs);
+  std::vector<Evaluations> count(slabs);
+#ifdef TINYMESH_STATISTICS
+  std::vector<Statistics> stats(slabs);
+#endif
 
-  // Intensities
-  double* a = new double[size];
-  double* b = new double[size];
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int s = 0; s < slabs; s++)
+  {
+    const int k0 = int((long long)(nz - 1) * s / slabs);
+    const int k1 = int((long long)(nz - 1) * (s + 1) / slabs);
+#ifdef TINYMESH_STATISTICS
+    PolygonizeSlab(*this, nx, ny, k0, k1, box, d, epsilon, finder, iterations, count[s], vertex[s], normal[s], triangle[s], top[s], &stats[s]);
+#else
+    PolygonizeSlab(*this, nx, ny, k0, k1, box, d, epsilon, finder, iterations, count[s], vertex[s], normal[s], triangle[s], top[s]);
+#endif
+  }
 
-  // Vertex
-  Vector* u = new Vector[size];
-  Vector* v = new Vector[size];
+  Evaluations total;
+  for (int s = 0; s < slabs; s++)
+  {
+    total += count[s];
+  }
+  evaluations = total;
+#ifdef TINYMESH_STATISTICS
+  Statistics summary;
+  for (int s = 0; s < slabs; s++)
+  {
+    summary += stats[s];
+  }
+  statistics = summary;
+#endif
 
-  // Edges
-  int* eax = new int[size];
-  int* eay = new int[size];
-  int* ebx = new int[size];
-  int* eby = new int[size];
-  int* ez = new int[size];
+  // Global index of the first vertex of every slab
+  std::vector<int> offset(slabs + 1, 0);
+  std::vector<int> toffset(slabs + 1, 0);
+  for (int s = 0; s < slabs; s++)
+  {
+    offset[s + 1] = offset[s] + int(vertex[s].size());
+    toffset[s + 1] = toffset[s] + int(triangle[s].size());
+  }
 
-  // Diagonal of a cell
-  Vector d = clipped.Diagonal() / (n - 1);
+  // Concatenate the geometry of the slabs, releasing every slab once copied
+  VertexArray vertices(precision);
+  VertexArray normals(precision);
+  vertices.reserve(offset[slabs]);
+  normals.reserve(offset[slabs]);
+  for (int s = 0; s < slabs; s++)
+  {
+    vertices.Append(vertex[s]);
+    normals.Append(normal[s]);
+    vertex[s] = VertexArray(precision);
+    normal[s] = VertexArray(precision);
+  }
 
-  double za = 0.0;
+  std::vector<int> triangles(toffset[slabs]);
 
-  // Compute field inside lower Oxy plane
-  for (int i = nax; i < nbx; i++)
+  // Stitch: shift local indexes and resolve references to the top plane of the previous slab
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int s = 0; s < slabs; s++)
   {
-    for (int j = nay; j < nby; j++)
+    for (int i = 0; i < int(triangle[s].size()); i++)
     {
-      u[i * ny + j] = clipped[0] + Vector(i * d[0], j * d[1], za);
-      a[i * ny + j] = Value(u[i * ny + j]);
+      int e = triangle[s][i];
+      if (e >= 0)
+      {
+        triangles[toffset[s] + i] = e + offset[s];
+      }
+      else
+      {
+        triangles[toffset[s] + i] = top[s - 1][-1 - e] + offset[s - 1];
+      }
     }
   }
 
-  // Compute straddling edges inside lower Oxy plane
-  for (int i = nax; i < nbx - 1; i++)
+  std::vector<int> nindexes = triangles;
+
+  g = Mesh(vertices, normals, triangles, nindexes);
+}
+
+/*!
+\brief Measure the scaling of AnalyticScalarField::PolygonizeParallel() with the number of threads.
+
+\param n Discretization parameter.
+\param box %Box defining the region that will be polygonized.
+\param threads Maximum number of threads, use all available cores if null or negative.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\return Wall time in seconds for 1, 2, ... threads, the first entry being the serial AnalyticScalarField::Polygonize().
+*/
+std::vector<double> AnalyticScalarField::PolygonizeScaling(int n, const Box& box, int threads, const double& epsilon) const
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  threads = 1;
+#endif
+
+  std::vector<double> timings;
+  Mesh g;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  Polygonize(n, g, box, epsilon);
+  timings.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+
+  for (int t = 2; t <= threads; t++)
+  {
+    start = std::chrono::high_resolution_clock::now();
+    PolygonizeParallel(n, g, box, t, epsilon);
+    timings.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+  }
+  return timings;
+}
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface, and stream it in batches instead of storing it.
+
+The grid is polygonized one slab of layers at a time, from bottom to top. The geometry of every slab is passed to the sink
+as soon as it is complete, with global vertex indexes: the vertices of a batch follow the vertices of the previous batches,
+and triangles may reference the vertices of the previous batch. The memory is bounded by the size of a slab,
+i.e. the number of layers times the size of a plane of the grid, and not by the size of the mesh.
+
+The concatenation of the batches is exactly the mesh produced by AnalyticScalarField::Polygonize().
+
+\param n Discretization parameter.
+\param box %Box defining the region that will be polygonized.
+\param sink Receiver of the batches, called in order.
+\param layers Number of layers of cells per slab.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::PolygonizeStream(int n, const Box& box, const Sink& sink, int layers, const double& epsilon) const
+{
+  const Vector d = box.Diagonal() / (n - 1);
+  layers = std::max(layers, 1);
+
+  VertexArray vertex;
+  VertexArray normal;
+  std::vector<int> triangle;
+  std::vector<int> top, previous;
+
+  // Global index of the first vertex of the current and previous slabs
+  int offset = 0;
+  int poffset = 0;
+
+  Evaluations count;
+#ifdef TINYMESH_STATISTICS
+  Statistics stats;
+#endif
+  for (int k0 = 0; k0 < n - 1; k0 += layers)
   {
-    for (int j = nay; j < nby; j++)
+    const int k1 = std::min(k0 + layers, n - 1);
+
+    vertex.clear();
+    normal.clear();
+    triangle.clear();
+    top.clear();
+#ifdef TINYMESH_STATISTICS
+    PolygonizeSlab(*this, n, n, k0, k1, box, d, epsilon, finder, iterations, count, vertex, normal, triangle, top, &stats);
+#else
+    PolygonizeSlab(*this, n, n, k0, k1, box, d, epsilon, finder, iterations, count, vertex, normal, triangle, top);
+#endif
+
+    // Resolve references to the top plane of the previous slab
+    for (int i = 0; i < int(triangle.size()); i++)
     {
-      // We need a xor b, which can be implemented a == !b 
-      if (!((a[i * ny + j] < 0.0) == !(a[(i + 1) * ny + j] >= 0.0)))
-      {
-        vertex.push_back(Dichotomy(u[i * ny + j], u[(i + 1) * ny + j], a[i * ny + j], a[(i + 1) * ny + j], d[0], epsilon));
-        normal.push_back(Normal(vertex.back()));
-        eax[i * ny + j] = nv;
-        nv++;
-      }
+      const int e = triangle[i];
+      triangle[i] = (e >= 0) ? e + offset : previous[-1 - e] + poffset;
     }
+
+    sink(vertex, normal, triangle);
+
+    previous.swap(top);
+    poffset = offset;
+    offset += int(vertex.size());
   }
-  for (int i = nax; i < nbx; i++)
+  evaluations = count;
+#ifdef TINYMESH_STATISTICS
+  statistics = stats;
+#endif
+}
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface, and write it to an .obj file as it is computed.
+\sa AnalyticScalarField::PolygonizeStream(int, const Box&, const Sink&, int, const double&) const
+\param n Discretization parameter.
+\param box %Box defining the region that will be polygonized.
+\param filename File name.
+\param layers Number of layers of cells per slab.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+\return False if the file could not be written.
+*/
+bool AnalyticScalarField::PolygonizeStream(int n, const Box& box, const std::string& filename, int layers, const double& epsilon) const
+{
+  std::ofstream out(filename);
+  if (!out)
   {
-    for (int j = nay; j < nby - 1; j++)
+    return false;
+  }
+
+  out << "g implicit\n";
+  PolygonizeStream(n, box, [&out](const VertexArray& vertex, const VertexArray& normal, const std::vector<int>& triangle)
     {
-      if (!((a[i * ny + j] < 0.0) == !(a[i * ny + (j + 1)] >= 0.0)))
+      for (int i = 0; i < vertex.size(); i++)
+      {
+        const Vector p = vertex[i];
+        out << "v " << p[0] << " " << p[1] << " " << p[2] << "\n";
+      }
+      for (int i = 0; i < normal.size(); i++)
       {
-        vertex.push_back(Dichotomy(u[i * ny + j], u[i * ny + (j + 1)], a[i * ny + j], a[i * ny + (j + 1)], d[1], epsilon));
-        normal.push_back(Normal(vertex.back()));
-        eay[i * ny + j] = nv;
-        nv++;
+        const Vector n = normal[i];
+        out << "vn " << n[0] << " " << n[1] << " " << n[2] << "\n";
       }
+      for (int i = 0; i < int(triangle.size()); i += 3)
+      {
+        out << "f " << triangle[i] + 1 << "//" << triangle[i] + 1 << " "
+          << triangle[i + 1] + 1 << "//" << triangle[i + 1] + 1 << " "
+          << triangle[i + 2] + 1 << "//" << triangle[i + 2] + 1 << "\n";
+      }
+    }, layers, epsilon);
+
+  return bool(out);
+}
+
+/*!
+\brief Internal data of the sparse octree polygonization.
+
+Field values at grid nodes and vertices on straddling edges are cached in hash tables
+keyed by their integer grid coordinates, so that shared nodes and edges are computed once.
+*/
+struct AnalyticScalarField::OctreeCache
+{
+  int n;              //!< Number of grid nodes along each axis.
+  Box box;            //!< Polygonized region.
+  Vector d;           //!< Diagonal of a cell.
+  double k;           //!< Lipschitz bound.
+  double epsilon;     //!< Epsilon for vertices on straddling edges.
+  Evaluations count;  //!< Field evaluations.
+#ifdef TINYMESH_STATISTICS
+  Statistics stats;   //!< Straddling cells and iterations of the root finder.
+#endif
+
+  std::unordered_map<long long, double> values; //!< Field values at grid nodes.
+  std::unordered_map<long long, int> edges;     //!< Vertex indexes on straddling edges.
+
+  VertexArray vertex;          //!< Vertices.
+  VertexArray normal;          //!< Normals.
+  std::vector<int> triangle;   //!< Triangle indexes.
+
+  //! Key of a grid node.
+  long long Key(int i, int j, int k) const
+  {
+    return (long long)(i * (long long)(n) + j) * n + k;
+  }
+
+  //! Position of a grid node.
+  Vector Point(int i, int j, int k) const
+  {
+    return box[0] + Vector(i * d[0], j * d[1], k * d[2]);
+  }
+};
+
+/*!
+\brief Compute the polygonal mesh approximating the implicit surface, skipping empty space.
+
+The grid is traversed with an octree: a node whose center value is greater than the Lipschitz
+bound times its half diagonal cannot contain the surface and is pruned. Only the cells near the surface
+are subdivided down to the resolution of the grid, therefore the number of field evaluations grows with
+the area of the surface instead of the volume of the box.
+
+All the straddling cells are polygonized at the same resolution with shared edge vertices, therefore
+the mesh is crack-free and is the same as the one obtained by marching cubes on the full grid.
+
+\param n Discretization parameter, number of grid nodes along each axis.
+\param g Returned geometry, with the storage it has on entry.
+\param box %Box defining the region that will be polygonized.
+\param k Lipschitz bound, use AnalyticScalarField::Lipschitz() if null or negative.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void AnalyticScalarField::PolygonizeOctree(int n, Mesh& g, const Box& box, double k, const double& epsilon) const
+{
+  OctreeCache cache;
+  cache.n = n;
+  cache.box = box;
+  cache.d = box.Diagonal() / (n - 1);
+  cache.k = k > 0.0 ? k : Lipschitz();
+  cache.epsilon = epsilon;
+  cache.vertex = VertexArray(g.GetPrecision());
+  cache.normal = VertexArray(g.GetPrecision());
+
+  // Root node, a power of two number of cells covering the grid
+  int s = 1;
+  while (s < n - 1)
+  {
+    s *= 2;
+  }
+
+#ifdef TINYMESH_STATISTICS
+  const auto start = std::chrono::high_resolution_clock::now();
+#endif
+
+  PolygonizeOctreeNode(cache, 0, 0, 0, s);
+  evaluations = cache.count;
+
+#ifdef TINYMESH_STATISTICS
+  cache.stats.evaluations = cache.count;
+  cache.stats.slabs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+  // Entries of the hash tables, without their buckets, and geometry
+  cache.stats.bytes += (long long)(cache.values.size()) * (sizeof(long long) + sizeof(double) + sizeof(void*));
+  cache.stats.bytes += (long long)(cache.edges.size()) * (sizeof(long long) + sizeof(int) + sizeof(void*));
+  cache.stats.bytes += cache.vertex.Memory() + cache.normal.Memory() + (long long)(cache.triangle.capacity() * sizeof(int));
+  statistics = cache.stats;
+#endif
+
+  std::vector<int> normals = cache.triangle;
+
+  g = Mesh(cache.vertex, cache.normal, cache.triangle, normals);
+}
+
+/*!
+\brief Recursively polygonize an octree node.
+\param cache Octree polygonization data.
+\param i,j,k Integer coordinates of the lower corner of the node.
+\param s Size of the node, in cells.
+*/
+void AnalyticScalarField::PolygonizeOctreeNode(OctreeCache& cache, int i, int j, int k, int s) const
+{
+  const int nc = cache.n - 1;
+
+  // Clip the node against the grid
+  const int si = std::min(s, nc - i);
+  const int sj = std::min(s, nc - j);
+  const int sk = std::min(s, nc - k);
+  if (si <= 0 || sj <= 0 || sk <= 0)
+  {
+    return;
+  }
+
+  if (s > 1)
+  {
+    // Empty space test with the Lipschitz bound
+    Vector a = cache.Point(i, j, k);
+    Vector b = cache.Point(i + si, j + sj, k + sk);
+    double r = 0.5 * Norm(b - a);
+    cache.count.classification++;
+    if (fabs(Value(0.5 * (a + b))) > cache.k * r)
+    {
+      return;
+    }
+
+    const int h = s / 2;
+    for (int o = 0; o < 8; o++)
+    {
+      PolygonizeOctreeNode(cache, i + ((o & 1) ? h : 0), j + ((o & 2) ? h : 0), k + ((o & 4) ? h : 0), h);
+    }
+    return;
+  }
+
+  // Leaf cell: field values at the corners, with the same vertex ordering as in PolygonizeSlab()
+  double v[8];
+  for (int c = 0; c < 8; c++)
+  {
+    const int ci = i + ((c & 1) ? 1 : 0);
+    const int cj = j + ((c & 2) ? 1 : 0);
+    const int ck = k + ((c & 4) ? 1 : 0);
+    const long long key = cache.Key(ci, cj, ck);
+    auto it = cache.values.find(key);
+    if (it == cache.values.end())
+    {
+      it = cache.values.emplace(key, Value(cache.Point(ci, cj, ck))).first;
+      cache.count.classification++;
     }
+    v[c] = it->second;
+  }
+
+  const int cubeindex = CubeIndex(v);
+
+  // Cube is not straddling the surface
+  if ((cubeindex == 255) || (cubeindex == 0))
+  {
+    return;
   }
+#ifdef TINYMESH_STATISTICS
+  cache.stats.cells++;
+  long long* steps = &cache.stats.iterations;
+#else
+  long long* steps = nullptr;
+#endif
+
+  int e[12];
+  for (int h = 0; h < 12; h++)
+  {
+    const int ca = CubeEdge[h][0];
+    const int cb = CubeEdge[h][1];
+
+    // Only edges with a sign change are referenced by the triangle table
+    if ((v[ca] < 0.0) == (v[cb] < 0.0))
+    {
+      continue;
+    }
+
+    const int ci = i + ((ca & 1) ? 1 : 0);
+    const int cj = j + ((ca & 2) ? 1 : 0);
+    const int ck = k + ((ca & 4) ? 1 : 0);
+    const long long key = cache.Key(ci, cj, ck) * 3 + CubeEdge[h][2];
+    auto it = cache.edges.find(key);
+    if (it == cache.edges.end())
+    {
+      Vector pa = cache.Point(ci, cj, ck);
+      Vector pb = cache.Point(i + ((cb & 1) ? 1 : 0), j + ((cb & 2) ? 1 : 0), k + ((cb & 4) ? 1 : 0));
+      Vector pc;
+      cache.count.roots += Roots(*this, finder, iterations, 1, &pa, &pb, &v[ca], &v[cb], cache.d[CubeEdge[h][2]], &pc, cache.epsilon, steps);
+      cache.count.normals++;
+      cache.vertex.push_back(pc);
+      cache.normal.push_back(Normal(pc));
+      it = cache.edges.emplace(key, int(cache.vertex.size()) - 1).first;
+    }
+    e[h] = it->second;
+  }
+
+  CubeTriangles(cubeindex, e, cache.triangle);
+}
+
+/*!
+\brief Create the triangles of a layer of cells between two planes of the grid.
+
+This is the cell emission of marching cubes shared by the polygonizations that traverse the grid plane by plane.
+The edge arrays are indexed by the first node of the edges, only the straddling edges need to be set.
+\param nx,ny Number of grid nodes along x and y.
+\param a,b Field values of the lower and upper planes.
+\param eax,eay Vertex indexes of the x and y edges of the lower plane.
+\param ebx,eby Vertex indexes of the x and y edges of the upper plane.
+\param ez Vertex indexes of the vertical edges.
+\param triangle Triangles.
+\return The number of straddling cells.
+*/
+long long AnalyticScalarField::PolygonizeLayer(int nx, int ny, const double* a, const double* b, const int* eax, const int* eay, const int* ebx, const int* eby, const int* ez, std::vector<int>& triangle)
+{
+  long long cells = 0;
 
   // Array for edge vertices
   int e[12];
 
-  // For all layers
-  for (int k = naz; k < nbz; k++)
+  for (int i = 0; i < nx - 1; i++)
   {
-    double zb = za + d[2];
-    for (int i = nax; i < nbx; i++)
+    for (int j = 0; j < ny - 1; j++)
     {
-      for (int j = nay; j < nby; j++)
+      int cubeindex = 0;
+      if (a[i * ny + j] < 0.0)       cubeindex |= 1;
+      if (a[(i + 1) * ny + j] < 0.0)   cubeindex |= 2;
+      if (a[i * ny + j + 1] < 0.0)     cubeindex |= 4;
+      if (a[(i + 1) * ny + j + 1] < 0.0) cubeindex |= 8;
+      if (b[i * ny + j] < 0.0)       cubeindex |= 16;
+      if (b[(i + 1) * ny + j] < 0.0)   cubeindex |= 32;
+      if (b[i * ny + j + 1] < 0.0)     cubeindex |= 64;
+      if (b[(i + 1) * ny + j + 1] < 0.0) cubeindex |= 128;
+
+      // Cube is straddling the surface
+      if ((cubeindex != 255) && (cubeindex != 0))
       {
-        v[i * ny + j] = clipped[0] + Vector(i * d[0], j * d[1], zb);
-        b[i * ny + j] = Value(v[i * ny + j]);
+        cells++;
+        e[0] = eax[i * ny + j];
+        e[1] = eax[i * ny + (j + 1)];
+        e[2] = ebx[i * ny + j];
+        e[3] = ebx[i * ny + (j + 1)];
+        e[4] = eay[i * ny + j];
+        e[5] = eay[(i + 1) * ny + j];
+        e[6] = eby[i * ny + j];
+        e[7] = eby[(i + 1) * ny + j];
+        e[8] = ez[i * ny + j];
+        e[9] = ez[(i + 1) * ny + j];
+        e[10] = ez[i * ny + (j + 1)];
+        e[11] = ez[(i + 1) * ny + (j + 1)];
+
+        CubeTriangles(cubeindex, e, triangle);
       }
     }
+  }
+  return cells;
+}
+
+/*!
+\brief Compute the first intersection between a ray and the implicit surface with sphere tracing.
+
+The ray is clipped by the box, and marched with steps equal to the absolute value of the field divided
+by the Lipschitz bound, so that the surface is never missed. The intersection is found when the absolute
+value of the field is lower than epsilon, which bounds the number of steps.
+\param ray The ray.
+\param box %Box containing the surface.
+\param t Returned parameter of the intersection along the ray.
+\param epsilon Precision.
+\return True if the ray intersects the surface.
+*/
+bool AnalyticScalarField::Intersect(const Ray& ray, const Box& box, double& t, const double& epsilon) const
+{
+  double ta, tb;
+  if (!box.Intersect(ray, ta, tb) || tb < 0.0)
+  {
+    return false;
+  }
 
-    // Compute straddling edges inside lower Oxy plane
-    for (int i = nax; i < nbx - 1; i++)
+  const double k = Lipschitz();
+  t = Math::Max(ta, 0.0);
+  while (t <= tb)
+  {
+    const double v = fabs(Value(ray(t)));
+    if (v < epsilon)
     {
-      for (int j = nay; j < nby; j++)
-      {
-        //   if (((b[i*ny + j] < 0.0) && (b[(i + 1)*ny + j] >= 0.0)) || ((b[i*ny + j] >= 0.0) && (b[(i + 1)*ny + j] < 0.0)))
-        if (!((b[i * ny + j] < 0.0) == !(b[(i + 1) * ny + j] >= 0.0)))
-        {
-          vertex.push_back(Dichotomy(v[i * ny + j], v[(i + 1) * ny + j], b[i * ny + j], b[(i + 1) * ny + j], d[0], epsilon));
-          normal.push_back(Normal(vertex.back()));
-          ebx[i * ny + j] = nv;
-          nv++;
-        }
-      }
+      return true;
     }
+    t += v / k;
+  }
+  return false;
+}
+
+/*!
+\brief Compute the first intersection between a set of rays and the implicit surface with sphere tracing.
+
+All the rays are marched in lockstep, every step evaluates the field at the current points
+of the rays that are still active with a single batched evaluation. The results are the same as
+calling AnalyticScalarField::Intersect() for every ray.
+\param n Number of rays.
+\param rays The rays.
+\param box %Box containing the surface.
+\param t Returned parameters of the intersections along the rays.
+\param hit Returned intersection flags, non zero for the rays that hit the surface.
+\param epsilon Precision.
+*/
+void AnalyticScalarField::Intersect(int n, const Ray* rays, const Box& box, double* t, char* hit, const double& epsilon) const
+{
+  const double k = Lipschitz();
 
-    for (int i = nax; i < nbx; i++)
+  std::vector<int> active;
+  std::vector<double> tb(n);
+  active.reserve(n);
+  for (int i = 0; i < n; i++)
+  {
+    double ta;
+    hit[i] = 0;
+    if (box.Intersect(rays[i], ta, tb[i]) && tb[i] >= 0.0)
     {
-      for (int j = nay; j < nby - 1; j++)
-      {
-        // if (((b[i*ny + j] < 0.0) && (b[i*ny + (j + 1)] >= 0.0)) || ((b[i*ny + j] >= 0.0) && (b[i*ny + (j + 1)] < 0.0)))
-        if (!((b[i * ny + j] < 0.0) == !(b[i * ny + (j + 1)] >= 0.0)))
-        {
-          vertex.push_back(Dichotomy(v[i * ny + j], v[i * ny + (j + 1)], b[i * ny + j], b[i * ny + (j + 1)], d[1], epsilon));
-          normal.push_back(Normal(vertex.back()));
-          eby[i * ny + j] = nv;
-          nv++;
-        }
-      }
+      t[i] = Math::Max(ta, 0.0);
+      active.push_back(i);
     }
+  }
 
-    // Create vertical straddling edges
-    for (int i = nax; i < nbx; i++)
+  std::vector<double> x(n), y(n), z(n), v(n);
+  while (!active.empty())
+  {
+    const int m = int(active.size());
+    for (int h = 0; h < m; h++)
     {
-      for (int j = nay; j < nby; j++)
-      {
-        // if ((a[i*ny + j] < 0.0) && (b[i*ny + j] >= 0.0) || (a[i*ny + j] >= 0.0) && (b[i*ny + j] < 0.0))
-        if (!((a[i * ny + j] < 0.0) == !(b[i * ny + j] >= 0.0)))
-        {
-          vertex.push_back(Dichotomy(u[i * ny + j], v[i * ny + j], a[i * ny + j], b[i * ny + j], d[2], epsilon));
-          normal.push_back(Normal(vertex.back()));
-          ez[i * ny + j] = nv;
-          nv++;
-        }
-      }
+      const Vector p = rays[active[h]](t[active[h]]);
+      x[h] = p[0];
+      y[h] = p[1];
+      z[h] = p[2];
     }
+    Values(x.data(), y.data(), z.data(), v.data(), m);
 
-    // Create mesh
-    for (int i = nax; i < nbx - 1; i++)
+    int q = 0;
+    for (int h = 0; h < m; h++)
     {
-      for (int j = nay; j < nby - 1; j++)
+      const int i = active[h];
+      const double a = fabs(v[h]);
+      if (a < epsilon)
+      {
+        hit[i] = 1;
+        continue;
+      }
+      t[i] += a / k;
+      if (t[i] <= tb[i])
       {
-        int cubeindex = 0;
-        if (a[i * ny + j] < 0.0)       cubeindex |= 1;
-        if (a[(i + 1) * ny + j] < 0.0)   cubeindex |= 2;
-        if (a[i * ny + j + 1] < 0.0)     cubeindex |= 4;
-        if (a[(i + 1) * ny + j + 1] < 0.0) cubeindex |= 8;
-        if (b[i * ny + j] < 0.0)       cubeindex |= 16;
-        if (b[(i + 1) * ny + j] < 0.0)   cubeindex |= 32;
-        if (b[i * ny + j + 1] < 0.0)     cubeindex |= 64;
-        if (b[(i + 1) * ny + j + 1] < 0.0) cubeindex |= 128;
-
-        // Cube is straddling the surface
-        if ((cubeindex != 255) && (cubeindex != 0))
-        {
-          e[0] = eax[i * ny + j];
-          e[1] = eax[i * ny + (j + 1)];
-          e[2] = ebx[i * ny + j];
-          e[3] = ebx[i * ny + (j + 1)];
-          e[4] = eay[i * ny + j];
-          e[5] = eay[(i + 1) * ny + j];
-          e[6] = eby[i * ny + j];
-          e[7] = eby[(i + 1) * ny + j];
-          e[8] = ez[i * ny + j];
-          e[9] = ez[(i + 1) * ny + j];
-          e[10] = ez[i * ny + (j + 1)];
-          e[11] = ez[(i + 1) * ny + (j + 1)];
-
-          for (int h = 0; TriangleTable[cubeindex][h] != -1; h += 3)
-          {
-            triangle.push_back(e[TriangleTable[cubeindex][h + 0]]);
-            triangle.push_back(e[TriangleTable[cubeindex][h + 1]]);
-            triangle.push_back(e[TriangleTable[cubeindex][h + 2]]);
-          }
-        }
+        active[q++] = i;
       }
     }
+    active.resize(q);
+  }
+}
 
-    std::swap(a, b);
+/*!
+\brief Render an image of the implicit surface with sphere tracing, without polygonizing it.
 
-    za = zb;
-    std::swap(eax, ebx);
-    std::swap(eay, eby);
-    std::swap(u, v);
+Rows are traced in parallel, the rays of a row with the batched AnalyticScalarField::Intersect().
+Pixels are shaded with the cosine between the normal and the ray direction.
+\param camera The camera.
+\param w,h Size of the image.
+\param box %Box containing the surface.
+\param threads Number of threads, use all available cores if null or negative.
+\param epsilon Precision.
+\return The colors of the pixels, row by row.
+*/
+std::vector<Color> AnalyticScalarField::Render(const Camera& camera, int w, int h, const Box& box, int threads, const double& epsilon) const
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
   }
+#else
+  (void)threads;
+#endif
+
+  std::vector<Color> image(size_t(w) * h, Color(1.0));
 
-  delete[]a;
-  delete[]b;
-  delete[]u;
-  delete[]v;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int y = 0; y < h; y++)
+  {
+    std::vector<Ray> rays(w);
+    std::vector<double> t(w);
+    std::vector<char> hit(w);
+    for (int x = 0; x < w; x++)
+    {
+      rays[x] = camera.PixelToRay(x, y, w, h);
+    }
+    Intersect(w, rays.data(), box, t.data(), hit.data(), epsilon);
+    for (int x = 0; x < w; x++)
+    {
+      if (hit[x])
+      {
+        const Vector n = Normal(rays[x](t[x]));
+        const double c = Math::Max(-(n * rays[x].Direction()), 0.0);
+        image[size_t(y) * w + x] = Color(0.15 + 0.75 * c);
+      }
+    }
+  }
+  return image;
+}
 
-  delete[]eax;
-  delete[]eay;
-  delete[]ebx;
-  delete[]eby;
-  delete[]ez;
+/*!
+\brief Compute the value of the field at a set of points.
 
-  std::vector<int> normals = triangle;
+Points are given as a structure of arrays. The default implementation calls
+AnalyticScalarField::Value() for every point, derived classes should override this
+function with a vectorized kernel.
 
-  g = Mesh(vertex, normal, triangle, normals);
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void AnalyticScalarField::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  for (int i = 0; i < n; i++)
+  {
+    v[i] = Value(Vector(x[i], y[i], z[i]));
+  }
 }
 
 /*!
@@ -276,18 +943,53 @@ Vector AnalyticScalarField::Dichotomy(Vector a, Vector b, double va, double vb,
   return c;
 }
 
+/*!
+\brief Compute the intersection between a set of segments of the same length and an implicit surface.
+
+\sa AnalyticScalarField::Dichotomy(const Field&, int, const Vector*, const Vector*, const double*, const double*, double, Vector*, const double&)
+\param n Number of segments.
+\param a,b End vertices of the segments straddling the surface.
+\param va,vb Field function value at those end vertices.
+\param length Distance between vertices.
+\param c Returned points on the implicit surface.
+\param epsilon Precision.
+*/
+void AnalyticScalarField::Dichotomy(int n, const Vector* a, const Vector* b, const double* va, const double* vb, double length, Vector* c, const double& epsilon) const
+{
+  Dichotomy(*this, n, a, b, va, vb, length, c, epsilon, iterations);
+}
 
 /*!
 \brief Compute the gradient of the field.
+
+The six samples of the central differences are evaluated with a single call to AnalyticScalarField::Values().
 \param p Point.
 */
 Vector AnalyticScalarField::Gradient(const Vector& p) const
 {
-  double x = Value(Vector(p[0] + Epsilon, p[1], p[2])) - Value(Vector(p[0] - Epsilon, p[1], p[2]));
-  double y = Value(Vector(p[0], p[1] + Epsilon, p[2])) - Value(Vector(p[0], p[1] - Epsilon, p[2]));
-  double z = Value(Vector(p[0], p[1], p[2] + Epsilon)) - Value(Vector(p[0], p[1], p[2] - Epsilon));
+  const double x[6] = { p[0] + Epsilon, p[0] - Epsilon, p[0], p[0], p[0], p[0] };
+  const double y[6] = { p[1], p[1], p[1] + Epsilon, p[1] - Epsilon, p[1], p[1] };
+  const double z[6] = { p[2], p[2], p[2], p[2], p[2] + Epsilon, p[2] - Epsilon };
+  double v[6];
+  Values(x, y, z, v, 6);
+
+  return Vector(v[0] - v[1], v[2] - v[3], v[4] - v[5]) * (0.5 / Epsilon);
+}
 
-  return Vector(x, y, z) * (0.5 / Epsilon);
+/*!
+\brief Compute the value and the gradient of the field.
+
+Fields with an analytic gradient should override this function together with AnalyticScalarField::Gradient(),
+so that the value and the gradient share their common terms. The default implementation
+falls back to AnalyticScalarField::Gradient(), i.e. to central differences.
+\param p Point.
+\param g Returned gradient.
+\return The value of the field.
+*/
+double AnalyticScalarField::ValueGradient(const Vector& p, Vector& g) const
+{
+  g = Gradient(p);
+  return Value(p);
 }
 
 /*!
@@ -305,6 +1007,127 @@ Vector AnalyticScalarField::Normal(const Vector& p) const
 }
 
 
+/*!
+\class SphereField implicits.h
+\brief Signed distance field of a sphere, with a vectorized batched evaluation.
+*/
+
+/*!
+\brief Create a sphere.
+\param c Center.
+\param r Radius.
+*/
+SphereField::SphereField(const Vector& c, double r) :c(c), r(r)
+{
+}
+
+/*!
+\brief Create the signed distance field of a Sphere.
+\param sphere The sphere.
+*/
+SphereField::SphereField(const Sphere& sphere) :c(sphere.getCenter()), r(sphere.getRadius())
+{
+}
+
+/*!
+\brief Compute the signed distance to the sphere.
+\param p Point.
+*/
+double SphereField::Value(const Vector& p) const
+{
+  const double x = p[0] - c[0];
+  const double y = p[1] - c[1];
+  const double z = p[2] - c[2];
+  return sqrt(x * x + y * y + z * z) - r;
+}
+
+/*!
+\brief Compute the signed distance to the sphere at a set of points.
+
+Uses AVX (four points) or SSE2 (two points) instructions when available.
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void SphereField::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  int i = 0;
+#if defined(__AVX__)
+  const __m256d cx = _mm256_set1_pd(c[0]);
+  const __m256d cy = _mm256_set1_pd(c[1]);
+  const __m256d cz = _mm256_set1_pd(c[2]);
+  const __m256d cr = _mm256_set1_pd(r);
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), cx);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), cy);
+    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), cz);
+    __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+    _mm256_storeu_pd(v + i, _mm256_sub_pd(_mm256_sqrt_pd(d), cr));
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128d cx = _mm_set1_pd(c[0]);
+  const __m128d cy = _mm_set1_pd(c[1]);
+  const __m128d cz = _mm_set1_pd(c[2]);
+  const __m128d cr = _mm_set1_pd(r);
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), cx);
+    __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), cy);
+    __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), cz);
+    __m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+    _mm_storeu_pd(v + i, _mm_sub_pd(_mm_sqrt_pd(d), cr));
+  }
+#endif
+  // Remaining points
+  for (; i < n; i++)
+  {
+    const double dx = x[i] - c[0];
+    const double dy = y[i] - c[1];
+    const double dz = z[i] - c[2];
+    v[i] = sqrt(dx * dx + dy * dy + dz * dz) - r;
+  }
+}
+
+/*!
+\brief Compute the analytic gradient of the signed distance.
+\param p Point.
+*/
+Vector SphereField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the sphere and its analytic gradient.
+
+The gradient is the unit vector from the center, it is set to the z axis at the center.
+\param p Point.
+\param g Returned gradient.
+*/
+double SphereField::ValueGradient(const Vector& p, Vector& g) const
+{
+  const Vector d = p - c;
+  const double l = Norm(d);
+  g = (l > 0.0) ? d / l : Vector::Z;
+  return l - r;
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double SphereField::Lipschitz() const
+{
+  return 1.0;
+}
+
+const int AnalyticScalarField::CubeEdge[12][3] = {
+  { 0, 1, 0 }, { 2, 3, 0 }, { 4, 5, 0 }, { 6, 7, 0 },
+  { 0, 2, 1 }, { 1, 3, 1 }, { 4, 6, 1 }, { 5, 7, 1 },
+  { 0, 4, 2 }, { 1, 5, 2 }, { 2, 6, 2 }, { 3, 7, 2 } };
+
 int AnalyticScalarField::edgeTable[256] = {
   0, 273, 545, 816, 1042, 1283, 1587, 1826, 2082, 2355, 2563, 2834, 3120, 3361, 3601, 3840,
   324, 85, 869, 628, 1366, 1095, 1911, 1638, 2406, 2167, 2887, 2646, 3444, 3173, 3925, 3652,
@@ -0,0 +1,668 @@
+// Bounding volume hierarchy of a mesh
+
+// Self include
+#include "mesh-bvh.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+\class MeshBVH mesh-bvh.h
+\brief Bounding volume hierarchy over the triangles of a mesh for ray queries.
+
+The hierarchy is built with the surface area heuristic evaluated over bins of triangle centers.
+The top of the tree is built first, then the subtrees are built in parallel. Nodes are flattened in depth first order
+into 32-byte records with single precision boxes rounded outwards, the first child following its parent:
+
+\code
+MeshBVH bvh(mesh);
+double t;
+int triangle;
+if (bvh.Intersect(ray, t, triangle))
+{
+  Vector p = ray(t);
+}
+\endcode
+
+The triangles of every leaf are copied in single precision into packets of four, see TrianglePacket, so that a ray is tested against
+four triangles at once with the watertight test, which neither misses the edges nor the vertices shared by triangles.
+After the vertices of the mesh have been moved, MeshBVH::Refit() updates the packets and the boxes without changing the structure of the tree.
+*/
+
+//! Construction of the hierarchy.
+struct MeshBVH::Builder
+{
+  //! Node of a tree under construction.
+  struct Item
+  {
+    Box box;   //!< Bounding box.
+    int child; //!< Index of the first child, the second one follows, -1 for a leaf, or -2-k for a reference to the k-th subtree.
+    int first; //!< Index of the first triangle.
+    int count; //!< Number of triangles.
+    int axis;  //!< Split axis.
+  };
+  //! Subtree built in parallel.
+  struct Task
+  {
+    int first; //!< Index of the first triangle.
+    int count; //!< Number of triangles.
+    int depth; //!< Depth of the root.
+  };
+
+  const std::vector<Box>& boxes;    //!< Bounding boxes of the triangles.
+  const std::vector<Vector>& centers; //!< Centers of the boxes of the triangles.
+  std::vector<int>& index;          //!< Triangles, partitioned in place.
+  int leaf;                         //!< Number of triangles below which nodes are not split.
+
+  Builder(const std::vector<Box>& boxes, const std::vector<Vector>& centers, std::vector<int>& index, int leaf) :boxes(boxes), centers(centers), index(index), leaf(leaf) {}
+
+  static double Area(const double*, const double*);
+  int Split(int, int, const Box&, int&) const;
+  void Build(std::vector<Item>&, int, int, int, int, int, std::vector<Task>*) const;
+  static void Flatten(const std::vector<std::vector<Item> >&, int, int, std::vector<Node>&);
+};
+
+/*!
+\brief Compute the area of a box given by its lower and upper vertices.
+\param a,b Lower and upper vertices.
+*/
+double MeshBVH::Builder::Area(const double* a, const double* b)
+{
+  const double x = b[0] - a[0];
+  const double y = b[1] - a[1];
+  const double z = b[2] - a[2];
+  return 2.0 * (x * y + y * z + z * x);
+}
+
+/*!
+\brief Partition a range of triangles with the surface area heuristic.
+
+Triangles are binned along the three axes in a single pass over the range.
+\param first,count Range of triangles.
+\param box Bounding box of the triangles.
+\param axis Returned split axis.
+\return Number of triangles in the first part, 0 if the range should not be split.
+*/
+int MeshBVH::Builder::Split(int first, int count, const Box& box, int& axis) const
+{
+  const int bins = 16;
+  const double infinity = std::numeric_limits<double>::infinity();
+
+  // Bounds of the centers
+  double lower[3] = { infinity, infinity, infinity };
+  double upper[3] = { -infinity, -infinity, -infinity };
+  for (int i = first; i < first + count; i++)
+  {
+    const Vector& c = centers[index[i]];
+    for (int a = 0; a < 3; a++)
+    {
+      lower[a] = Math::Min(lower[a], c[a]);
+      upper[a] = Math::Max(upper[a], c[a]);
+    }
+  }
+  double scale[3];
+  for (int a = 0; a < 3; a++)
+  {
+    scale[a] = (upper[a] > lower[a]) ? bins / (upper[a] - lower[a]) : 0.0;
+  }
+
+  // Number of triangles and bounds of their boxes in the bins of every axis
+  int n[3][bins] = { { 0 } };
+  double lo[3][bins][3], hi[3][bins][3];
+  for (int a = 0; a < 3; a++)
+  {
+    for (int k = 0; k < bins; k++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        lo[a][k][c] = infinity;
+        hi[a][k][c] = -infinity;
+      }
+    }
+  }
+  for (int i = first; i < first + count; i++)
+  {
+    const int t = index[i];
+    const Box& b = boxes[t];
+    for (int a = 0; a < 3; a++)
+    {
+      const int k = std::min(int((centers[t][a] - lower[a]) * scale[a]), bins - 1);
+      n[a][k]++;
+      for (int c = 0; c < 3; c++)
+      {
+        lo[a][k][c] = Math::Min(lo[a][k][c], b[0][c]);
+        hi[a][k][c] = Math::Max(hi[a][k][c], b[1][c]);
+      }
+    }
+  }
+
+  double best = infinity;
+  int split = -1;
+  for (int a = 0; a < 3; a++)
+  {
+    if (scale[a] == 0.0)
+    {
+      continue;
+    }
+
+    // Sweep from the right, then from the left
+    double right[bins];
+    int nr[bins];
+    double l[3] = { infinity, infinity, infinity };
+    double h[3] = { -infinity, -infinity, -infinity };
+    int sum = 0;
+    for (int k = bins - 1; k > 0; k--)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        l[c] = Math::Min(l[c], lo[a][k][c]);
+        h[c] = Math::Max(h[c], hi[a][k][c]);
+      }
+      sum += n[a][k];
+      right[k] = (sum > 0) ? Area(l, h) * sum : 0.0;
+      nr[k] = sum;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      l[c] = infinity;
+      h[c] = -infinity;
+    }
+    sum = 0;
+    for (int k = 0; k < bins - 1; k++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        l[c] = Math::Min(l[c], lo[a][k][c]);
+        h[c] = Math::Max(h[c], hi[a][k][c]);
+      }
+      sum += n[a][k];
+      if (sum > 0 && nr[k + 1] > 0)
+      {
+        const double cost = Area(l, h) * sum + right[k + 1];
+        if (cost < best)
+        {
+          best = cost;
+          axis = a;
+          split = k + 1;
+        }
+      }
+    }
+  }
+
+  if (split < 0)
+  {
+    return 0;
+  }
+
+  // Splitting costs one traversal step, worth it if intersecting all the triangles costs more
+  const double bl[3] = { box[0][0], box[0][1], box[0][2] };
+  const double bh[3] = { box[1][0], box[1][1], box[1][2] };
+  const double area = Area(bl, bh);
+  if (count <= 4 * leaf && area + best >= area * count)
+  {
+    return 0;
+  }
+
+  const int a = axis;
+  int* middle = std::partition(index.data() + first, index.data() + first + count, [&](int t)
+    {
+      return std::min(int((centers[t][a] - lower[a]) * scale[a]), bins - 1) < split;
+    });
+  return int(middle - (index.data() + first));
+}
+
+/*!
+\brief Build a tree over a range of triangles.
+\param tree Tree, whose node i is set.
+\param i Index of the node.
+\param first,count Range of triangles.
+\param depth Depth of the node.
+\param grain Number of triangles below which subtrees are deferred as tasks.
+\param tasks Deferred subtrees, nothing is deferred if null.
+*/
+void MeshBVH::Builder::Build(std::vector<Item>& tree, int i, int first, int count, int depth, int grain, std::vector<Task>* tasks) const
+{
+  Box box = boxes[index[first]];
+  for (int j = first + 1; j < first + count; j++)
+  {
+    const Box& b = boxes[index[j]];
+    for (int c = 0; c < 3; c++)
+    {
+      box[0][c] = Math::Min(box[0][c], b[0][c]);
+      box[1][c] = Math::Max(box[1][c], b[1][c]);
+    }
+  }
+  tree[i].box = box;
+  tree[i].first = first;
+  tree[i].count = count;
+  tree[i].child = -1;
+  tree[i].axis = 0;
+
+  if (count <= leaf || depth >= 64)
+  {
+    return;
+  }
+  if (tasks != nullptr && count <= grain)
+  {
+    tree[i].child = -2 - int(tasks->size());
+    tasks->push_back(Task{ first, count, depth });
+    return;
+  }
+
+  int axis = 0;
+  const int left = Split(first, count, box, axis);
+  if (left == 0)
+  {
+    return;
+  }
+
+  const int c = int(tree.size());
+  tree.resize(c + 2);
+  tree[i].child = c;
+  tree[i].axis = axis;
+  Build(tree, c, first, left, depth + 1, grain, tasks);
+  Build(tree, c + 1, first + left, count - left, depth + 1, grain, tasks);
+}
+
+/*!
+\brief Append a tree to the flattened hierarchy in depth first order.
+\param trees Top of the tree followed by the subtrees.
+\param t Index of the tree.
+\param i Index of the node in the tree.
+\param nodes Flattened hierarchy.
+*/
+void MeshBVH::Builder::Flatten(const std::vector<std::vector<Item> >& trees, int t, int i, std::vector<Node>& nodes)
+{
+  const Item& item = trees[t][i];
+  if (item.child <= -2)
+  {
+    Flatten(trees, 1 + (-2 - item.child), 0, nodes);
+    return;
+  }
+
+  const int n = int(nodes.size());
+  nodes.push_back(Node());
+  Round(item.box, nodes[n].box);
+  if (item.child == -1)
+  {
+    nodes[n].offset = item.first;
+    nodes[n].count = item.count;
+    nodes[n].axis = 0;
+    return;
+  }
+  nodes[n].count = 0;
+  nodes[n].axis = item.axis;
+  Flatten(trees, t, item.child, nodes);
+  nodes[n].offset = int(nodes.size());
+  Flatten(trees, t, item.child + 1, nodes);
+}
+
+/*!
+\brief Build the hierarchy of a mesh.
+\param mesh The mesh.
+\param leaf Number of triangles below which nodes are not split.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+MeshBVH::MeshBVH(const Mesh& mesh, int leaf, int threads)
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  threads = 1;
+#endif
+
+  const int nt = mesh.Triangles();
+  if (nt == 0)
+  {
+    return;
+  }
+
+  std::vector<Box> boxes(nt);
+  std::vector<Vector> centers(nt);
+  index.resize(nt);
+#pragma omp parallel for num_threads(threads)
+  for (int i = 0; i < nt; i++)
+  {
+    boxes[i] = mesh.GetTriangle(i).GetBox();
+    centers[i] = boxes[i].Center();
+    index[i] = i;
+  }
+
+  // Top of the tree, then subtrees in parallel
+  const Builder builder(boxes, centers, index, std::max(leaf, 1));
+  std::vector<std::vector<Builder::Item> > trees(1, std::vector<Builder::Item>(1));
+  std::vector<Builder::Task> tasks;
+  const int grain = (threads > 1) ? std::max(nt / (8 * threads), 1024) : nt;
+  trees[0].reserve(2 * (nt / grain) + 16);
+  builder.Build(trees[0], 0, 0, nt, 0, grain, &tasks);
+
+  trees.resize(1 + tasks.size());
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int k = 0; k < int(tasks.size()); k++)
+  {
+    std::vector<Builder::Item>& tree = trees[1 + k];
+    tree.reserve(2 * (tasks[k].count / builder.leaf) + 1);
+    tree.resize(1);
+    builder.Build(tree, 0, tasks[k].first, tasks[k].count, tasks[k].depth, 0, nullptr);
+  }
+
+  nodes.reserve(2 * (nt / builder.leaf) + 1);
+  Builder::Flatten(trees, 0, 0, nodes);
+
+  // Leaves, whose triangles follow each other in depth first order, start on a packet
+  std::vector<int> lanes;
+  lanes.reserve(size_t(nt) + 3 * (nt / builder.leaf + 1));
+  for (Node& node : nodes)
+  {
+    if (node.count == 0)
+    {
+      continue;
+    }
+    const int first = node.offset;
+    node.offset = int(lanes.size() / 4);
+    lanes.insert(lanes.end(), index.begin() + first, index.begin() + first + node.count);
+    lanes.resize((lanes.size() + 3) & ~size_t(3), -1);
+  }
+  index.swap(lanes);
+
+  const int np = int(index.size() / 4);
+  packets.resize(np);
+#pragma omp parallel for num_threads(threads)
+  for (int k = 0; k < np; k++)
+  {
+    for (int l = 0; l < 4 && index[4 * size_t(k) + l] >= 0; l++)
+    {
+      const int t = index[4 * size_t(k) + l];
+      packets[k].Set(l, mesh.Vertex(t, 0), mesh.Vertex(t, 1), mesh.Vertex(t, 2));
+    }
+  }
+}
+
+/*!
+\brief Round a box outwards to single precision.
+\param box The box.
+\param b Returned lower and upper vertices.
+*/
+void MeshBVH::Round(const Box& box, float* b)
+{
+  for (int a = 0; a < 3; a++)
+  {
+    float lo = float(box[0][a]);
+    float hi = float(box[1][a]);
+    if (lo > box[0][a])
+    {
+      lo = std::nextafter(lo, -std::numeric_limits<float>::infinity());
+    }
+    if (hi < box[1][a])
+    {
+      hi = std::nextafter(hi, std::numeric_limits<float>::infinity());
+    }
+    b[a] = lo;
+    b[3 + a] = hi;
+  }
+}
+
+/*!
+\brief Update the boxes of the nodes bottom-up.
+
+Children are stored after their parent, therefore nodes are processed in reverse order.
+\param threads Number of threads.
+*/
+void MeshBVH::Fit(int threads)
+{
+#ifndef _OPENMP
+  (void)threads;
+#endif
+  const int nn = int(nodes.size());
+
+  // Leaves
+#pragma omp parallel for num_threads(threads)
+  for (int i = 0; i < nn; i++)
+  {
+    Node& node = nodes[i];
+    if (node.count == 0)
+    {
+      continue;
+    }
+    // Vertices are already in single precision
+    float* b = node.box;
+    for (int a = 0; a < 3; a++)
+    {
+      b[a] = std::numeric_limits<float>::infinity();
+      b[3 + a] = -std::numeric_limits<float>::infinity();
+    }
+    for (int k = node.offset; k < node.offset + (int(node.count) + 3) / 4; k++)
+    {
+      const TrianglePacket4& packet = packets[k];
+      for (int l = 0; l < packet.count; l++)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          for (int a = 0; a < 3; a++)
+          {
+            b[a] = std::min(b[a], packet.p[j][a][l]);
+            b[3 + a] = std::max(b[3 + a], packet.p[j][a][l]);
+          }
+        }
+      }
+    }
+  }
+
+  // Internal nodes
+  for (int i = nn - 1; i >= 0; i--)
+  {
+    Node& node = nodes[i];
+    if (node.count != 0)
+    {
+      continue;
+    }
+    const float* a = nodes[i + 1].box;
+    const float* b = nodes[node.offset].box;
+    for (int k = 0; k < 3; k++)
+    {
+      node.box[k] = std::min(a[k], b[k]);
+      node.box[3 + k] = std::max(a[3 + k], b[3 + k]);
+    }
+  }
+}
+
+/*!
+\brief Update the hierarchy after the vertices of the mesh have been moved.
+
+The triangles should be the same as the ones of the mesh the hierarchy was built with. The tree is not rebuilt,
+so that its quality degrades with large deformations.
+\param mesh The mesh.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+void MeshBVH::Refit(const Mesh& mesh, int threads)
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  threads = 1;
+#endif
+
+  const int np = int(packets.size());
+#pragma omp parallel for num_threads(threads)
+  for (int k = 0; k < np; k++)
+  {
+    for (int l = 0; l < 4 && index[4 * size_t(k) + l] >= 0; l++)
+    {
+      const int t = index[4 * size_t(k) + l];
+      packets[k].Set(l, mesh.Vertex(t, 0), mesh.Vertex(t, 1), mesh.Vertex(t, 2));
+    }
+  }
+  Fit(threads);
+}
+
+/*!
+\brief Check whether a ray crosses a box before a given depth.
+
+Slabs are ordered with the signs of the direction, and NaN produced by rays parallel to a face are ignored by the comparisons.
+\param b Lower and upper vertices of the box.
+\param o Origin of the ray.
+\param inv Inverse of the direction of the ray.
+\param sign Whether the components of the direction are negative.
+\param tmax Depth.
+*/
+static inline bool Slab(const float* b, const Vector& o, const double* inv, const int* sign, double tmax)
+{
+  double t0 = 0.0;
+  double t1 = tmax;
+  for (int a = 0; a < 3; a++)
+  {
+    const double ta = (b[3 * sign[a] + a] - o[a]) * inv[a];
+    const double tb = (b[3 * (1 - sign[a]) + a] - o[a]) * inv[a];
+    t0 = (ta > t0) ? ta : t0;
+    t1 = (tb < t1) ? tb : t1;
+  }
+  return t0 <= t1;
+}
+
+/*!
+\brief Compute the closest intersection between a ray and the mesh.
+\param ray The ray.
+\param t Returned intersection depth.
+\param u,v Returned parametric coordinates of the intersection in the triangle, see Triangle::Vertex().
+\param triangle Returned index of the triangle in the mesh.
+\param tmax Intersections beyond this depth are ignored.
+*/
+bool MeshBVH::Intersect(const Ray& ray, double& t, double& u, double& v, int& triangle, double tmax) const
+{
+  if (nodes.empty())
+  {
+    return false;
+  }
+
+  const Vector o = ray.Origin();
+  const Vector d = ray.Direction();
+  const double inv[3] = { 1.0 / d[0], 1.0 / d[1], 1.0 / d[2] };
+  const int sign[3] = { inv[0] < 0.0, inv[1] < 0.0, inv[2] < 0.0 };
+  const WatertightRay w(ray);
+
+  int stack[128];
+  int top = 0;
+  int n = 0;
+  int hit = -1;
+  double best = tmax;
+  while (true)
+  {
+    const Node& node = nodes[n];
+    if (Slab(node.box, o, inv, sign, best))
+    {
+      if (node.count == 0)
+      {
+        // Visit the nearest child first
+        if (sign[node.axis])
+        {
+          stack[top++] = n + 1;
+          n = node.offset;
+        }
+        else
+        {
+          stack[top++] = node.offset;
+          n = n + 1;
+        }
+        continue;
+      }
+      for (int k = node.offset; k < node.offset + (int(node.count) + 3) / 4; k++)
+      {
+        float s, a, b;
+        const int l = packets[k].Intersect(w, s, a, b, float(best));
+        if (l >= 0)
+        {
+          best = s;
+          u = a;
+          v = b;
+          hit = 4 * k + l;
+        }
+      }
+    }
+    if (top == 0)
+    {
+      break;
+    }
+    n = stack[--top];
+  }
+
+  if (hit < 0)
+  {
+    return false;
+  }
+  t = best;
+  triangle = index[hit];
+  return true;
+}
+
+/*!
+\brief Compute the closest intersection between a ray and the mesh.
+\param ray The ray.
+\param t Returned intersection depth.
+\param triangle Returned index of the triangle in the mesh.
+\param tmax Intersections beyond this depth are ignored.
+*/
+bool MeshBVH::Intersect(const Ray& ray, double& t, int& triangle, double tmax) const
+{
+  double u, v;
+  return Intersect(ray, t, u, v, triangle, tmax);
+}
+
+/*!
+\brief Check whether a ray intersects the mesh before a given depth, such as for shadow rays.
+
+The traversal stops at the first intersection found.
+\param ray The ray.
+\param tmax Depth.
+*/
+bool MeshBVH::Occluded(const Ray& ray, double tmax) const
+{
+  if (nodes.empty())
+  {
+    return false;
+  }
+
+  const Vector o = ray.Origin();
+  const Vector d = ray.Direction();
+  const double inv[3] = { 1.0 / d[0], 1.0 / d[1], 1.0 / d[2] };
+  const int sign[3] = { inv[0] < 0.0, inv[1] < 0.0, inv[2] < 0.0 };
+  const WatertightRay w(ray);
+  const float depth = float(tmax);
+
+  int stack[128];
+  int top = 0;
+  int n = 0;
+  while (true)
+  {
+    const Node& node = nodes[n];
+    if (Slab(node.box, o, inv, sign, tmax))
+    {
+      if (node.count == 0)
+      {
+        stack[top++] = node.offset;
+        n = n + 1;
+        continue;
+      }
+      for (int k = node.offset; k < node.offset + (int(node.count) + 3) / 4; k++)
+      {
+        if (packets[k].Occluded(w, depth))
+        {
+          return true;
+        }
+      }
+    }
+    if (top == 0)
+    {
+      return false;
+    }
+    n = stack[--top];
+  }
+}
@@ -0,0 +1,503 @@
+// Mesh distance field
+
+// Self include
+#include "mesh-distance.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+\class MeshDistanceField mesh-distance.h
+\brief Signed distance field of a triangle mesh.
+
+The field turns any mesh, including meshes loaded with Mesh::Load(), into an implicit surface
+that can be combined with analytic primitives in an ImplicitNode tree and polygonized:
+
+\code
+Mesh bunny;
+bunny.Load("bunny.obj");
+MeshDistanceField field(bunny);
+
+Mesh mesh;
+field.Polygonize(128, mesh, field.GetBox());
+\endcode
+
+The closest point is computed with a bounding volume hierarchy over the triangles. The sign is given by the angle weighted
+pseudo-normal of the closest feature, face, edge or vertex, which is exact for closed manifold meshes.
+The orientation of the triangles is deduced from the signed volume of the mesh, so that the field is negative inside.
+
+Queries can be accelerated by sampling the distance on a grid with MeshDistanceField::Precompute(): distances are computed
+only in a narrow band around the surface, and the sign is propagated along the rows of the grid elsewhere.
+*/
+
+/*!
+\brief Create the distance field of a mesh.
+\param mesh The mesh, which should be closed and consistently oriented for the sign to be meaningful.
+\param leaf Maximum number of triangles in a leaf of the hierarchy.
+*/
+MeshDistanceField::MeshDistanceField(const Mesh& mesh, int leaf) :nx(0), ny(0), nz(0), band(0.0)
+{
+  const int nt = mesh.Triangles();
+
+  // Orientation of the triangles from the signed volume
+  double volume = 0.0;
+  for (int i = 0; i < nt; i++)
+  {
+    const Triangle t = mesh.GetTriangle(i);
+    volume += t[0] * (t[1] / t[2]);
+  }
+  const double orientation = volume < 0.0 ? -1.0 : 1.0;
+
+  // Face normals, angle weighted vertex normals and edge normals
+  std::vector<Vector> fn(nt);
+  std::vector<Vector> vn(mesh.Vertexes(), Vector::Null);
+  std::unordered_map<long long, Vector> en;
+  for (int i = 0; i < nt; i++)
+  {
+    const Triangle t = mesh.GetTriangle(i);
+    const Vector n = orientation * t.AreaNormal();
+    fn[i] = (SquaredNorm(n) > 0.0) ? Normalized(n) : Vector::Null;
+    for (int k = 0; k < 3; k++)
+    {
+      const Vector u = t[(k + 1) % 3] - t[k];
+      const Vector v = t[(k + 2) % 3] - t[k];
+      const double uv = Norm(u) * Norm(v);
+      if (uv > 0.0)
+      {
+        vn[mesh.VertexIndex(i, k)] += acos(Math::Clamp((u * v) / uv, -1.0, 1.0)) * fn[i];
+      }
+
+      const long long a = mesh.VertexIndex(i, k);
+      const long long b = mesh.VertexIndex(i, (k + 1) % 3);
+      en[std::min(a, b) * mesh.Vertexes() + std::max(a, b)] += fn[i];
+    }
+  }
+
+  // Bounding boxes and centers of the triangles
+  std::vector<Box> boxes(nt);
+  std::vector<Vector> centers(nt);
+  std::vector<int> index(nt);
+  for (int i = 0; i < nt; i++)
+  {
+    const Triangle t = mesh.GetTriangle(i);
+    boxes[i] = t.GetBox();
+    centers[i] = t.Center();
+    index[i] = i;
+  }
+
+  nodes.reserve(2 * (nt / std::max(leaf, 1)) + 1);
+  nodes.push_back(Node());
+  Build(0, 0, nt, std::max(leaf, 1), index, centers, boxes);
+
+  // Triangles and pseudo-normals in the order of the leaves
+  triangles.resize(nt);
+  pseudo.resize(7 * size_t(nt));
+  for (int j = 0; j < nt; j++)
+  {
+    const int i = index[j];
+    triangles[j] = mesh.GetTriangle(i);
+    pseudo[7 * j] = fn[i];
+    for (int k = 0; k < 3; k++)
+    {
+      const long long a = mesh.VertexIndex(i, k);
+      const long long b = mesh.VertexIndex(i, (k + 1) % 3);
+      pseudo[7 * j + 1 + k] = vn[a];
+      pseudo[7 * j + 4 + k] = en[std::min(a, b) * mesh.Vertexes() + std::max(a, b)];
+    }
+  }
+}
+
+/*!
+\brief Build the hierarchy by recursively splitting the triangles at the median of their centers along the largest axis.
+\param node Index of the node.
+\param first, last Range of triangles.
+\param leaf Maximum number of triangles in a leaf.
+\param index Indexes of the triangles, reordered.
+\param centers Centers of the triangles.
+\param boxes Bounding boxes of the triangles.
+*/
+void MeshDistanceField::Build(int node, int first, int last, int leaf, std::vector<int>& index, const std::vector<Vector>& centers, const std::vector<Box>& boxes)
+{
+  Box box = (last > first) ? boxes[index[first]] : Box(0.0);
+  Box cbox = (last > first) ? Box(centers[index[first]], 0.0) : Box(0.0);
+  for (int i = first + 1; i < last; i++)
+  {
+    box = Box(box, boxes[index[i]]);
+    cbox = Box(cbox, Box(centers[index[i]], 0.0));
+  }
+  nodes[node].box = box;
+
+  if (last - first <= leaf)
+  {
+    nodes[node].left = -1;
+    nodes[node].first = first;
+    nodes[node].count = last - first;
+    return;
+  }
+
+  const Vector size = cbox.Size();
+  const int axis = (size[0] > size[1]) ? (size[0] > size[2] ? 0 : 2) : (size[1] > size[2] ? 1 : 2);
+  const int mid = (first + last) / 2;
+  std::nth_element(index.begin() + first, index.begin() + mid, index.begin() + last, [&centers, axis](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+  const int left = int(nodes.size());
+  nodes[node].left = left;
+  nodes[node].first = 0;
+  nodes[node].count = 0;
+  nodes.push_back(Node());
+  nodes.push_back(Node());
+  Build(left, first, mid, leaf, index, centers, boxes);
+  Build(left + 1, mid, last, leaf, index, centers, boxes);
+}
+
+/*!
+\brief Compute the closest point of a triangle.
+\param t %Triangle.
+\param p Point.
+\param feature Returned closest feature: 0 for the face, 1 to 3 for the vertices, 4 to 6 for the edges starting at those vertices.
+*/
+Vector MeshDistanceField::Closest(const Triangle& t, const Vector& p, int& feature)
+{
+  const Vector ab = t[1] - t[0];
+  const Vector ac = t[2] - t[0];
+
+  const Vector ap = p - t[0];
+  const double d1 = ab * ap;
+  const double d2 = ac * ap;
+  if (d1 <= 0.0 && d2 <= 0.0)
+  {
+    feature = 1;
+    return t[0];
+  }
+
+  const Vector bp = p - t[1];
+  const double d3 = ab * bp;
+  const double d4 = ac * bp;
+  if (d3 >= 0.0 && d4 <= d3)
+  {
+    feature = 2;
+    return t[1];
+  }
+
+  const double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+  {
+    feature = 4;
+    return t[0] + (d1 / (d1 - d3)) * ab;
+  }
+
+  const Vector cp = p - t[2];
+  const double d5 = ab * cp;
+  const double d6 = ac * cp;
+  if (d6 >= 0.0 && d5 <= d6)
+  {
+    feature = 3;
+    return t[2];
+  }
+
+  const double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+  {
+    feature = 6;
+    return t[0] + (d2 / (d2 - d6)) * ac;
+  }
+
+  const double va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+  {
+    feature = 5;
+    return t[1] + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (t[2] - t[1]);
+  }
+
+  const double denom = 1.0 / (va + vb + vc);
+  feature = 0;
+  return t[0] + (vb * denom) * ab + (vc * denom) * ac;
+}
+
+/*!
+\brief Find the closest point of the mesh.
+
+Nodes are visited nearest first, and pruned if their box is farther than the current closest point.
+\param p Point.
+\param r Search radius, triangles farther than this distance are ignored.
+\param q Returned closest point.
+\param t Returned index of the closest triangle, -1 if none was found within the search radius.
+\param feature Returned closest feature of the triangle.
+\return The squared distance, or the squared search radius if no triangle was found.
+*/
+double MeshDistanceField::Closest(const Vector& p, double r, Vector& q, int& t, int& feature) const
+{
+  double best = r * r;
+  t = -1;
+
+  int stack[64];
+  int ns = 0;
+  stack[ns++] = 0;
+  while (ns > 0)
+  {
+    const Node& node = nodes[stack[--ns]];
+    const double b = node.box.Distance(p);
+    if (b * b >= best)
+    {
+      continue;
+    }
+
+    if (node.left < 0)
+    {
+      for (int i = node.first; i < node.first + node.count; i++)
+      {
+        int f;
+        const Vector c = Closest(triangles[i], p, f);
+        const double d2 = SquaredNorm(p - c);
+        if (d2 < best)
+        {
+          best = d2;
+          q = c;
+          t = i;
+          feature = f;
+        }
+      }
+    }
+    else
+    {
+      // Push the farthest child first so that the nearest one is visited first
+      const double dl = nodes[node.left].box.Distance(p);
+      const double dr = nodes[node.left + 1].box.Distance(p);
+      if (dl < dr)
+      {
+        stack[ns++] = node.left + 1;
+        stack[ns++] = node.left;
+      }
+      else
+      {
+        stack[ns++] = node.left;
+        stack[ns++] = node.left + 1;
+      }
+    }
+  }
+  return best;
+}
+
+/*!
+\brief Compute the exact signed distance to the mesh and its gradient.
+
+The gradient is the direction from the closest point, oriented by the pseudo-normal of the closest feature.
+\param p Point.
+\param g Returned gradient.
+*/
+double MeshDistanceField::Signed(const Vector& p, Vector& g) const
+{
+  Vector q;
+  int t, feature = 0;
+  const double d2 = Closest(p, std::numeric_limits<double>::infinity(), q, t, feature);
+  if (t < 0)
+  {
+    g = Vector::Null;
+    return std::numeric_limits<double>::infinity();
+  }
+
+  const Vector n = pseudo[7 * t + feature];
+  const double s = ((p - q) * n < 0.0) ? -1.0 : 1.0;
+  const double d = sqrt(d2);
+  g = (d > 0.0) ? (s / d) * (p - q) : pseudo[7 * t];
+  return s * d;
+}
+
+/*!
+\brief Compute the signed distance to the mesh.
+
+If the field has been precomputed, points inside the grid use the trilinear interpolation of the samples.
+\param p Point.
+*/
+double MeshDistanceField::Value(const Vector& p) const
+{
+  if (!field.empty() && grid.Inside(p))
+  {
+    return Trilinear(p);
+  }
+  Vector g;
+  return Signed(p, g);
+}
+
+/*!
+\brief Compute the gradient of the exact signed distance, which is always a closest point query.
+\param p Point.
+*/
+Vector MeshDistanceField::Gradient(const Vector& p) const
+{
+  Vector g;
+  Signed(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the value and the gradient.
+
+If the field has been precomputed, points inside the grid use the trilinear interpolation of the samples and its gradient,
+so that both are consistent, otherwise this is a single closest point query.
+\param p Point.
+\param g Returned gradient.
+*/
+double MeshDistanceField::ValueGradient(const Vector& p, Vector& g) const
+{
+  if (!field.empty() && grid.Inside(p))
+  {
+    return Trilinear(p, g);
+  }
+  return Signed(p, g);
+}
+
+/*!
+\brief Return the Lipschitz constant.
+
+The signed distance is 1-Lipschitz. The trilinear interpolation of the precomputed samples is bounded by the norm of the
+largest slope along every axis, hence the square root of 3.
+*/
+double MeshDistanceField::Lipschitz() const
+{
+  return field.empty() ? 1.0 : sqrt(3.0);
+}
+
+/*!
+\brief Sample the signed distance on a grid over the box of the mesh.
+
+Distances are computed only for grid nodes within the narrow band, with a search radius equal to the band,
+and other nodes are clamped to plus or minus the band. The sign of those nodes is propagated along the rows of the grid from the
+previous node, since the surface cannot cross an edge between two nodes outside of the band, and a full query is only needed
+for the first node of a row. Rows are sampled in parallel.
+\param n Number of grid nodes along the largest axis of the box.
+\param width Half width of the narrow band, in number of cells, at least 1.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+void MeshDistanceField::Precompute(int n, double width, int threads)
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  (void)threads;
+#endif
+
+  width = Math::Max(width, 1.0);
+  field.clear();
+
+  // Cubic cells over the box enlarged by the band
+  const Box box = GetBox();
+  const Vector size = box.Size();
+  const double c = Math::Max(size[0], size[1], size[2]) / (n - 1);
+  band = width * c;
+  grid = Box(box[0] - Vector(band), box[1] + Vector(band));
+  nx = int(ceil(grid.Size()[0] / c)) + 1;
+  ny = int(ceil(grid.Size()[1] / c)) + 1;
+  nz = int(ceil(grid.Size()[2] / c)) + 1;
+  d = Vector(c);
+  grid[1] = grid[0] + Vector((nx - 1) * c, (ny - 1) * c, (nz - 1) * c);
+
+  std::vector<double> samples(size_t(nx) * ny * nz);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int k = 0; k < nz; k++)
+  {
+    for (int j = 0; j < ny; j++)
+    {
+      double s = 0.0;
+      for (int i = 0; i < nx; i++)
+      {
+        const Vector p = grid[0] + Vector(i * d[0], j * d[1], k * d[2]);
+
+        Vector q;
+        int t, feature = 0;
+        const double d2 = Closest(p, band, q, t, feature);
+
+        double v;
+        if (t >= 0)
+        {
+          v = ((p - q) * pseudo[7 * t + feature] < 0.0) ? -sqrt(d2) : sqrt(d2);
+        }
+        else if (s != 0.0)
+        {
+          v = s * band;
+        }
+        else
+        {
+          Vector g;
+          v = (Signed(p, g) < 0.0) ? -band : band;
+        }
+        s = (v < 0.0) ? -1.0 : 1.0;
+        samples[(size_t(k) * ny + j) * nx + i] = v;
+      }
+    }
+  }
+
+  field.swap(samples);
+}
+
+/*!
+\brief Compute the trilinear interpolation of the precomputed samples.
+\param p Point, inside the grid.
+*/
+double MeshDistanceField::Trilinear(const Vector& p) const
+{
+  double u[3];
+  int c[3];
+  const int s[3] = { nx, ny, nz };
+  for (int a = 0; a < 3; a++)
+  {
+    const double t = Math::Clamp((p[a] - grid[0][a]) / d[a], 0.0, double(s[a] - 1));
+    c[a] = std::min(int(t), s[a] - 2);
+    u[a] = t - c[a];
+  }
+
+  auto value = [this](int i, int j, int k) { return field[(size_t(k) * ny + j) * nx + i]; };
+  const int i = c[0], j = c[1], l = c[2];
+  const double x00 = (1.0 - u[0]) * value(i, j, l) + u[0] * value(i + 1, j, l);
+  const double x10 = (1.0 - u[0]) * value(i, j + 1, l) + u[0] * value(i + 1, j + 1, l);
+  const double x01 = (1.0 - u[0]) * value(i, j, l + 1) + u[0] * value(i + 1, j, l + 1);
+  const double x11 = (1.0 - u[0]) * value(i, j + 1, l + 1) + u[0] * value(i + 1, j + 1, l + 1);
+  const double y0 = (1.0 - u[1]) * x00 + u[1] * x10;
+  const double y1 = (1.0 - u[1]) * x01 + u[1] * x11;
+  return (1.0 - u[2]) * y0 + u[2] * y1;
+}
+
+/*!
+\brief Compute the trilinear interpolation of the precomputed samples and its gradient.
+\param p Point, inside the grid.
+\param g Returned gradient.
+*/
+double MeshDistanceField::Trilinear(const Vector& p, Vector& g) const
+{
+  double u[3];
+  int c[3];
+  const int s[3] = { nx, ny, nz };
+  for (int a = 0; a < 3; a++)
+  {
+    const double t = Math::Clamp((p[a] - grid[0][a]) / d[a], 0.0, double(s[a] - 1));
+    c[a] = std::min(int(t), s[a] - 2);
+    u[a] = t - c[a];
+  }
+
+  auto value = [this](int i, int j, int k) { return field[(size_t(k) * ny + j) * nx + i]; };
+  const int i = c[0], j = c[1], l = c[2];
+  const double v000 = value(i, j, l), v100 = value(i + 1, j, l), v010 = value(i, j + 1, l), v110 = value(i + 1, j + 1, l);
+  const double v001 = value(i, j, l + 1), v101 = value(i + 1, j, l + 1), v011 = value(i, j + 1, l + 1), v111 = value(i + 1, j + 1, l + 1);
+  const double x00 = (1.0 - u[0]) * v000 + u[0] * v100;
+  const double x10 = (1.0 - u[0]) * v010 + u[0] * v110;
+  const double x01 = (1.0 - u[0]) * v001 + u[0] * v101;
+  const double x11 = (1.0 - u[0]) * v011 + u[0] * v111;
+  const double y0 = (1.0 - u[1]) * x00 + u[1] * x10;
+  const double y1 = (1.0 - u[1]) * x01 + u[1] * x11;
+
+  // Derivatives with respect to the local coordinates, scaled by the size of the cell
+  const double dx0 = (1.0 - u[1]) * (v100 - v000) + u[1] * (v110 - v010);
+  const double dx1 = (1.0 - u[1]) * (v101 - v001) + u[1] * (v111 - v011);
+  g = Vector(((1.0 - u[2]) * dx0 + u[2] * dx1) / d[0], ((1.0 - u[2]) * (x10 - x00) + u[2] * (x11 - x01)) / d[1], (y1 - y0) / d[2]);
+
+  return (1.0 - u[2]) * y0 + u[2] * y1;
+}
@@ -0,0 +1,298 @@
+// Adjacency of a triangle mesh
+
+// Self include
+#include "mesh-topology.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+\class MeshTopology mesh-topology.h
+\brief Adjacency of a triangle mesh: triangles sharing every vertex, edges, opposite half-edges and boundary flags.
+
+The corner 3t+i is the vertex i of the triangle t, and the half-edge 3t+i goes from the vertex i to the vertex i+1 of the triangle t,
+so that both are given by the index of the triangle and need not be stored. The triangles sharing a vertex are stored in compressed form,
+and the edges are numbered by increasing smaller vertex index and then by increasing greater vertex index.
+
+The topology is usually obtained from the mesh, which builds it on demand and keeps it until its triangles change:
+
+\code
+const MeshTopology& topology = mesh.Topology();
+for (int h = 0; h < 3 * mesh.Triangles(); h++)
+{
+  if (topology.Opposite(h) == -1) { ... } // Boundary or non-manifold half-edge
+}
+\endcode
+
+Every vertex pairs the half-edges of its corners, so that the construction is parallel without atomic operations
+and gives the same result whatever the number of threads.
+*/
+
+/*!
+\brief Build the adjacency of a set of triangles.
+\param varray Vertex indexes of the triangles.
+\param n Number of vertices.
+\param threads Number of threads, all available threads if 0.
+*/
+MeshTopology::MeshTopology(const std::vector<int>& varray, int n, int threads) :nv(n)
+{
+#ifdef _OPENMP
+  if (threads <= 0) threads = omp_get_max_threads();
+#else
+  threads = 1;
+#endif
+  BuildCorners(varray, nv, threads, first, corners);
+  BuildEdges(varray, threads);
+}
+
+/*!
+\brief Build the corners of the triangles sharing every vertex, in compressed form.
+
+This is a two-pass bucketed counting sort. The vertices are split into at most one contiguous block per thread, and the corners into as many
+contiguous ranges: the corners of every range are first bucketed by block, then the corners of every block are counted and scattered
+per vertex. The scratch memory is one index per corner and the square of the number of threads, whatever the number of vertices,
+and the corners of every vertex are stored in increasing order whatever the number of threads.
+\param varray Vertex indexes of the triangles.
+\param n Number of vertices.
+\param threads Number of threads, all available threads if 0.
+\param first Returned index of the first corner of every vertex, and total number of corners.
+\param corners Returned corners of the triangles sharing every vertex, sorted by vertex and then by triangle.
+*/
+void MeshTopology::BuildCorners(const std::vector<int>& varray, int n, int threads, std::vector<int>& first, std::vector<int>& corners)
+{
+#ifdef _OPENMP
+  if (threads <= 0) threads = omp_get_max_threads();
+#else
+  threads = 1;
+#endif
+  const int nc = int(varray.size());
+
+  first.assign(n + 1, 0);
+  corners.resize(nc);
+  if (n == 0)
+  {
+    return;
+  }
+
+  // Blocks of a power of two number of vertices, at most one per thread, so that the block of a vertex is a shift, and ranges of corners
+  int shift = 0;
+  while (((n - 1) >> shift) >= std::max(threads, 1))
+  {
+    shift++;
+  }
+  const int m = ((n - 1) >> shift) + 1;
+  auto block = [shift](int v) { return v >> shift; };
+  auto start = [shift, n](int b) { return int(std::min((long long)(b) << shift, (long long)(n))); };
+  auto range = [nc, m](int r) { return int((long long)(nc) * r / m); };
+
+  // Corners bucketed by block, in increasing order within every block, unless there is a single block
+  std::vector<int> bucket(m > 1 ? nc : 0);
+  std::vector<int> slot(size_t(m) * m, 0);
+  std::vector<int> origin(m + 1, nc);
+  origin[0] = 0;
+
+#pragma omp parallel num_threads(m)
+  {
+    if (m > 1)
+    {
+      // Number of corners of every range in every block, counted in a local array so that threads do not share cache lines
+      std::vector<int> count(m);
+#pragma omp for schedule(static)
+      for (int r = 0; r < m; r++)
+      {
+        std::fill(count.begin(), count.end(), 0);
+        for (int i = range(r); i < range(r + 1); i++)
+        {
+          count[block(varray[i])]++;
+        }
+        std::copy(count.begin(), count.end(), slot.begin() + size_t(r) * m);
+      }
+
+      // Exclusive prefix over the blocks and then the ranges
+#pragma omp single
+      {
+        int s = 0;
+        for (int b = 0; b < m; b++)
+        {
+          origin[b] = s;
+          for (int r = 0; r < m; r++)
+          {
+            const int c = slot[size_t(r) * m + b];
+            slot[size_t(r) * m + b] = s;
+            s += c;
+          }
+        }
+      }
+
+#pragma omp for schedule(static)
+      for (int r = 0; r < m; r++)
+      {
+        std::copy(slot.begin() + size_t(r) * m, slot.begin() + size_t(r + 1) * m, count.begin());
+        for (int i = range(r); i < range(r + 1); i++)
+        {
+          bucket[count[block(varray[i])]++] = i;
+        }
+      }
+    }
+
+    // Valence of the vertices of every block, then first corner of every vertex shifted by one, used as the cursor of the scatter
+#pragma omp for schedule(static)
+    for (int b = 0; b < m; b++)
+    {
+      const int lo = origin[b];
+      const int hi = origin[b + 1];
+      for (int i = lo; i < hi; i++)
+      {
+        first[varray[(m > 1) ? bucket[i] : i] + 1]++;
+      }
+      int s = lo;
+      for (int v = start(b); v < start(b + 1); v++)
+      {
+        const int c = first[v + 1];
+        first[v + 1] = s;
+        s += c;
+      }
+      for (int i = lo; i < hi; i++)
+      {
+        const int c = (m > 1) ? bucket[i] : i;
+        corners[first[varray[c] + 1]++] = c;
+      }
+    }
+  }
+}
+
+/*!
+\brief Sort the half-edges of a vertex by other vertex and then by index.
+\param keys Half-edges, with the index of their other vertex in the upper bits.
+*/
+static void Sort(std::vector<long long>& keys)
+{
+  if (keys.size() > 32)
+  {
+    std::sort(keys.begin(), keys.end());
+    return;
+  }
+  // Insertion sort is faster for the few half-edges of most vertices
+  for (int i = 1; i < int(keys.size()); i++)
+  {
+    const long long k = keys[i];
+    int j = i;
+    for (; j > 0 && keys[j - 1] > k; j--)
+    {
+      keys[j] = keys[j - 1];
+    }
+    keys[j] = k;
+  }
+}
+
+/*!
+\brief Build the edges, the opposite half-edges and the boundary flags.
+
+Every vertex sorts its half-edges by other vertex: half-edges with the same other vertex share an edge, which belongs
+to the smaller vertex, and a single half-edge marks the vertex as a boundary vertex.
+\param varray Vertex indexes of the triangles.
+\param threads Number of threads.
+*/
+void MeshTopology::BuildEdges(const std::vector<int>& varray, int threads)
+{
+#ifndef _OPENMP
+  (void)threads;
+#endif
+  const int nc = int(varray.size());
+  edge.resize(nc);
+  opposite.resize(nc);
+  boundary.resize(nv);
+  std::vector<int> offset(nv + 1, 0);
+  std::vector<unsigned char> count(nc, 0);
+
+  // Edges of every vertex, numbered locally, the number of half-edges being stored in the first half-edge
+#pragma omp parallel num_threads(threads)
+  {
+    std::vector<long long> keys;
+#pragma omp for schedule(static)
+    for (int v = 0; v < nv; v++)
+    {
+      keys.clear();
+      for (int j = first[v]; j < first[v + 1]; j++)
+      {
+        // Outgoing and incoming half-edges of the corner, with their other vertex
+        const int c = corners[j];
+        const int t = c - c % 3;
+        const int he[2] = { c, t + (c + 2) % 3 };
+        const int w[2] = { varray[t + (c + 1) % 3], varray[he[1]] };
+        for (int k = 0; k < 2; k++)
+        {
+          if (w[k] != v)
+          {
+            keys.push_back(((long long)(w[k]) << 32) | he[k]);
+          }
+        }
+      }
+      Sort(keys);
+
+      char b = 0;
+      int local = 0;
+      for (int i = 0; i < int(keys.size());)
+      {
+        const int o = int(keys[i] >> 32);
+        int j = i + 1;
+        while (j < int(keys.size()) && int(keys[j] >> 32) == o)
+        {
+          j++;
+        }
+        const int n = j - i;
+        if (n == 1)
+        {
+          b = 1;
+        }
+        if (o > v)
+        {
+          for (int l = i; l < j; l++)
+          {
+            const int h = int(keys[l] & 0xffffffff);
+            edge[h] = local;
+            opposite[h] = (n == 2) ? int(keys[2 * i + 1 - l] & 0xffffffff) : -1;
+          }
+          count[int(keys[i] & 0xffffffff)] = (unsigned char)(std::min(n, 255));
+          local++;
+        }
+        i = j;
+      }
+      boundary[v] = b;
+      offset[v + 1] = local;
+    }
+  }
+  for (int v = 0; v < nv; v++)
+  {
+    offset[v + 1] += offset[v];
+  }
+
+  // Global numbering of the edges
+  const int ne = offset[nv];
+  edges.resize(2 * ne);
+  shared.resize(ne);
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int h = 0; h < nc; h++)
+  {
+    const int a = varray[h];
+    const int b = varray[h - h % 3 + (h + 1) % 3];
+    if (a == b)
+    {
+      edge[h] = -1;
+      opposite[h] = -1;
+      continue;
+    }
+    const int v = std::min(a, b);
+    const int e = offset[v] + edge[h];
+    edge[h] = e;
+    if (count[h] != 0)
+    {
+      edges[2 * e] = v;
+      edges[2 * e + 1] = std::max(a, b);
+      shared[e] = count[h];
+    }
+  }
+}
@@ -46,20 +46,37 @@ MeshWidget::MeshGL::MeshGL(const Mesh& mesh, const Vector& position) : MeshGL()
     int singleBufferSize = nbVertex * 3;
     float* vertices = new float[singleBufferSize];
     float* normals = new float[singleBufferSize];
-    for (int i = 0; i < nbVertex; i++)
+    if (mesh.GetPrecision() == VertexArray::Float)
     {
-        int indexVertex = vertexIndexes[i];
-        int indexNormal = normalIndexes[i];
-
-        Vector vertex = mesh.Vertex(indexVertex);
-        vertices[i * 3 + 0] = float(vertex[0]);
-        vertices[i * 3 + 1] = float(vertex[1]);
-        vertices[i * 3 + 2] = float(vertex[2]);
-
-        Vector normal = mesh.Normal(indexNormal);
-        normals[i * 3 + 0] = float(normal[0]);
-        normals[i * 3 + 1] = float(normal[1]);
-        normals[i * 3 + 2] = float(normal[2]);
+        // Gather the single precision coordinates directly, without going through vectors
+        for (int c = 0; c < 3; c++)
+        {
+            const float* vc = mesh.VertexCoordinates(c);
+            const float* nc = mesh.NormalCoordinates(c);
+            for (int i = 0; i < nbVertex; i++)
+            {
+                vertices[i * 3 + c] = vc[vertexIndexes[i]];
+                normals[i * 3 + c] = nc[normalIndexes[i]];
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < nbVertex; i++)
+        {
+            int indexVertex = vertexIndexes[i];
+            int indexNormal = normalIndexes[i];
+
+            Vector vertex = mesh.Vertex(indexVertex);
+            vertices[i * 3 + 0] = float(vertex[0]);
+            vertices[i * 3 + 1] = float(vertex[1]);
+            vertices[i * 3 + 2] = float(vertex[2]);
+
+            Vector normal = mesh.Normal(indexNormal);
+            normals[i * 3 + 0] = float(normal[0]);
+            normals[i * 3 + 1] = float(normal[1]);
+            normals[i * 3 + 2] = float(normal[2]);
+        }
     }
     // Indices are now sorted
     int* indices = new int[nbVertex];
@@ -127,21 +144,38 @@ MeshWidget::MeshGL::MeshGL(const MeshColor& mesh, const Vector& fr) : MeshGL()
     float* vertices = new float[singleBufferSize];
     float* normals = new float[singleBufferSize];
     float* colors = new float[singleBufferSize];
+    if (mesh.GetPrecision() == VertexArray::Float)
+    {
+        // Gather the single precision coordinates directly, without going through vectors
+        for (int c = 0; c < 3; c++)
+        {
+            const float* vc = mesh.VertexCoordinates(c);
+            const float* nc = mesh.NormalCoordinates(c);
+            for (int i = 0; i < nbVertex; i++)
+            {
+                vertices[i * 3 + c] = vc[vertexIndexes[i]];
+                normals[i * 3 + c] = nc[normalIndexes[i]];
+            }
+        }
+    }
     for (int i = 0; i < nbVertex; i++)
     {
         int indexVertex = vertexIndexes[i];
         int indexNormal = normalIndexes[i];
         int indexColor = colorIndexes[i];
 
-        Vector vertex = mesh.Vertex(indexVertex);
-        vertices[i * 3 + 0] = float(vertex[0]);
-        vertices[i * 3 + 1] = float(vertex[1]);
-        vertices[i * 3 + 2] = float(vertex[2]);
-
-        Vector normal = mesh.Normal(indexNormal);
-        normals[i * 3 + 0] = float(normal[0]);
-        normals[i * 3 + 1] = float(normal[1]);
-        normals[i * 3 + 2] = float(normal[2]);
+        if (mesh.GetPrecision() == VertexArray::Double)
+        {
+            Vector vertex = mesh.Vertex(indexVertex);
+            vertices[i * 3 + 0] = float(vertex[0]);
+            vertices[i * 3 + 1] = float(vertex[1]);
+            vertices[i * 3 + 2] = float(vertex[2]);
+
+            Vector normal = mesh.Normal(indexNormal);
+            normals[i * 3 + 0] = float(normal[0]);
+            normals[i * 3 + 1] = float(normal[1]);
+            normals[i * 3 + 2] = float(normal[2]);
+        }
 
         Color color = mesh.GetColor(indexColor);
         colors[i * 3 + 0] = float(color[0]);
@@ -662,6 +696,15 @@ QPoint MeshWidget::GetMousePosition() const
     return QPoint(x0, y0);
 }
 
+/*!
+\brief Set additional lines displayed in the stats panel, such as the instrumentation of a polygonization.
+\param lines Lines of text.
+*/
+void MeshWidget::SetStatistics(const QStringList& lines)
+{
+    statistics = lines;
+}
+
 /*!
 \brief Render the stats panel of the widget.
 */
@@ -683,7 +726,7 @@ void MeshWidget::RenderStats()
     const int bX = 10;
     const int bY = 10;
     const int sizeX = 200;
-    const int sizeY = 65;
+    const int sizeY = 65 + 15 * int(statistics.size());
 
     // Background
     painter.setPen(penLineGrey);
@@ -700,6 +743,8 @@ void MeshWidget::RenderStats()
     painter.drawText(10 + 5, bY + 10 + 20, "CPU FPS:\t" + QString::number(profiler.framePerSecond));
     painter.drawText(10 + 5, bY + 10 + 35, "CPU Frame:\t" + QString::number(profiler.msPerFrame) + "ms");
     painter.drawText(10 + 5, bY + 10 + 50, "GPU:\t" + QString::number(profiler.elapsedTimeGPU / 1000000.0) + "ms");
+    for (int i = 0; i < int(statistics.size()); i++)
+        painter.drawText(10 + 5, bY + 10 + 65 + 15 * i, statistics[i]);
 
     painter.end();
 
@@ -1,17 +1,37 @@
 #include "mesh.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /*!
 \class Mesh mesh.h
 
 \brief Core triangle mesh class.
-*/
 
+Vertices and normals are stored in a VertexArray, either in double precision or in single precision which halves
+the memory of large meshes. Meshes are created in double precision unless the storage is given to the constructor,
+and the storage of an existing mesh is changed with SetPrecision():
+
+\code
+Mesh sphere(Sphere(1.0), 1000, VertexArray::Float);
+\endcode
+
+Polygonizers keep the storage of the mesh they are given, so that large surfaces are built in single precision
+without a copy in double precision:
+
+\code
+Mesh surface(VertexArray::Float);
+field.Polygonize(512, surface, box);
+\endcode
+*/
 
 
 /*!
 \brief Initialize the mesh to empty.
+\param precision Storage of the vertices and normals.
 */
-Mesh::Mesh()
+Mesh::Mesh(VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
 }
 
@@ -22,8 +42,9 @@ Indices must have a size multiple of three (three for triangle vertices and thre
 
 \param vertices List of geometry vertices.
 \param indices List of indices wich represent the geometry triangles.
+\param precision Storage of the vertices and normals.
 */
-Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<int>& indices) :vertices(vertices), varray(indices)
+Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<int>& indices, VertexArray::Precision precision) :vertices(vertices, precision), normals(precision), varray(indices)
 {
   normals.resize(vertices.size(), Vector::Z);
 }
@@ -34,8 +55,20 @@ Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<int>& indices)
 \param vertices Array of vertices.
 \param normals Array of normals.
 \param va, na Array of vertex and normal indexes.
+\param precision Storage of the vertices and normals.
 */
-Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<Vector>& normals, const std::vector<int>& va, const std::vector<int>& na) :vertices(vertices), normals(normals), varray(va), narray(na)
+Mesh::Mesh(const std::vector<Vector>& vertices, const std::vector<Vector>& normals, const std::vector<int>& va, const std::vector<int>& na, VertexArray::Precision precision) :vertices(vertices, precision), normals(normals, precision), varray(va), narray(na)
+{
+}
+
+/*!
+\brief Create the mesh with the storage of the arrays of vertices and normals.
+
+\param vertices Array of vertices.
+\param normals Array of normals, with the same storage.
+\param va, na Array of vertex and normal indexes.
+*/
+Mesh::Mesh(const VertexArray& vertices, const VertexArray& normals, const std::vector<int>& va, const std::vector<int>& na) :vertices(vertices), normals(normals), varray(va), narray(na)
 {
 }
 
@@ -59,34 +92,173 @@ Mesh::~Mesh()
 }
 
 /*!
-\brief Smooth the normals of the mesh.
+\brief Return the adjacency of the mesh, which is built on the first call and kept until the triangles change.
 
-This function weights the normals of the faces by their corresponding area.
-\sa Triangle::AreaNormal()
+The first call should not be made concurrently from several threads.
+\param threads Number of threads for building the adjacency, all available threads if 0.
 */
-void Mesh::SmoothNormals()
+const MeshTopology& Mesh::Topology(int threads) const
 {
-  // Initialize 
-  normals.resize(vertices.size(), Vector::Null);
+  if (!topology || topology->Vertexes() != vertices.size())
+  {
+    topology = std::make_shared<const MeshTopology>(varray, vertices.size(), threads);
+  }
+  return *topology;
+}
 
-  narray = varray;
+/*!
+\brief Discard the adjacency of the mesh, every function changing the triangles or the number of vertices should call it.
+*/
+void Mesh::Invalidate()
+{
+  topology.reset();
+}
 
-  // Accumulate normals
-  for (int i = 0; i < varray.size(); i += 3)
+/*!
+\brief Compute the normals of the vertices from the normals of their faces.
+
+The normals of the faces and the angles at their corners are computed in the given precision, which is the storage of the mesh.
+Without corners, the normals of the faces are scattered to their vertices in the order of the triangles, on a single thread.
+Otherwise every vertex gathers the normals of its faces in parallel, which sums them in the same order.
+\param vertices, varray Vertices and vertex indexes of the triangles.
+\param first, corners Corners of the triangles sharing every vertex, see MeshTopology::BuildCorners(), null for scattering.
+\param weighting Weighting of the normals of the faces.
+\param threads Number of threads.
+\param normals Returned normals, one per vertex.
+*/
+template<typename Real>
+static void AverageNormals(const VertexArray& vertices, const std::vector<int>& varray, const std::vector<int>* first, const std::vector<int>* corners, Mesh::Weighting weighting, int threads, VertexArray& normals)
+{
+  const int nv = vertices.size();
+  const int nt = int(varray.size()) / 3;
+
+  // Normal of a face, and angles at its corners
+  auto face = [&](int t, Real* f, Real* angle)
+    {
+      const Vector a = vertices[varray[3 * t]];
+      const Vector b = vertices[varray[3 * t + 1]];
+      const Vector c = vertices[varray[3 * t + 2]];
+      Vector n = 0.5 * ((b - a) / (c - a));
+      if (weighting == Mesh::Angle)
+      {
+        // The sine of the angles is given by the norm of the cross product
+        const Vector e[3] = { b - a, c - b, a - c };
+        const double l = Norm(n);
+        for (int i = 0; i < 3; i++)
+        {
+          angle[i] = Real(atan2(2.0 * l, -(e[i] * e[(i + 2) % 3])));
+        }
+        n = (l > 0.0) ? n / l : Vector::Null;
+      }
+      f[0] = Real(n[0]);
+      f[1] = Real(n[1]);
+      f[2] = Real(n[2]);
+    };
+
+  normals.clear();
+  normals.resize(nv);
+
+  if (first == nullptr)
   {
-    Vector tn = Triangle(vertices[varray.at(i)], vertices[varray.at(i + 1)], vertices[varray.at(i + 2)]).AreaNormal();
-    normals[narray[i + 0]] += tn;
-    normals[narray[i + 1]] += tn;
-    normals[narray[i + 2]] += tn;
+    std::vector<Vector> sum(nv, Vector::Null);
+    for (int t = 0; t < nt; t++)
+    {
+      Real f[3], angle[3];
+      face(t, f, angle);
+      for (int i = 0; i < 3; i++)
+      {
+        const double w = (weighting == Mesh::Area) ? 1.0 : angle[i];
+        sum[varray[3 * t + i]] += Vector(w * f[0], w * f[1], w * f[2]);
+      }
+    }
+    for (int i = 0; i < nv; i++)
+    {
+      const double l = Norm(sum[i]);
+      normals.Set(i, (l > 0.0) ? sum[i] / l : Vector::Null);
+    }
+    return;
   }
 
-  // Normalize 
-  for (int i = 0; i < normals.size(); i++)
+  std::vector<Real> faces(3 * size_t(nt));
+  std::vector<Real> angles((weighting == Mesh::Angle) ? 3 * size_t(nt) : 3);
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int t = 0; t < nt; t++)
   {
-    Normalize(normals[i]);
+    face(t, &faces[3 * size_t(t)], &angles[(weighting == Mesh::Angle) ? 3 * size_t(t) : 0]);
+  }
+
+  // Gather
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int i = 0; i < nv; i++)
+  {
+    Vector n = Vector::Null;
+    for (int j = (*first)[i]; j < (*first)[i + 1]; j++)
+    {
+      const int c = (*corners)[j];
+      const Real* f = &faces[c - c % 3];
+      const double w = (weighting == Mesh::Area) ? 1.0 : angles[c];
+      n += Vector(w * f[0], w * f[1], w * f[2]);
+    }
+    const double l = Norm(n);
+    normals.Set(i, (l > 0.0) ? n / l : Vector::Null);
   }
 }
 
+/*!
+\brief Smooth the normals of the mesh.
+
+This function computes one normal per vertex by averaging the normals of the faces sharing the vertex, weighted by their area
+or by their angle at the vertex. Angle weighting does not depend on the triangulation of the surface.
+
+With several threads, vertices gather the normals of their faces in parallel instead of faces scattering them. The corners of every vertex
+come from the adjacency of the mesh if it has been built, otherwise they are built for this call only, without the edges, and are not kept.
+A single thread scatters the normals of the faces and needs no adjacency. Faces are summed in the same order in all cases,
+so that the result does not depend on the number of threads.
+The normals of the faces are computed in the precision of the storage of the mesh.
+Vertices that do not belong to any triangle get a null normal.
+\param weighting Weighting of the normals of the faces.
+\param threads Number of threads, all available threads if 0.
+\sa Triangle::AreaNormal()
+*/
+void Mesh::SmoothNormals(Weighting weighting, int threads)
+{
+#ifdef _OPENMP
+  if (threads <= 0) threads = omp_get_max_threads();
+#else
+  threads = 1;
+#endif
+  const int nv = vertices.size();
+
+  std::vector<int> vfirst, vcorners;
+  const std::vector<int>* first = nullptr;
+  const std::vector<int>* corners = nullptr;
+  if (threads > 1)
+  {
+    if (topology && topology->Vertexes() == nv)
+    {
+      first = &topology->First();
+      corners = &topology->Corners();
+    }
+    else
+    {
+      MeshTopology::BuildCorners(varray, nv, threads, vfirst, vcorners);
+      first = &vfirst;
+      corners = &vcorners;
+    }
+  }
+
+  if (vertices.GetPrecision() == VertexArray::Double)
+  {
+    AverageNormals<double>(vertices, varray, first, corners, weighting, threads, normals);
+  }
+  else
+  {
+    AverageNormals<float>(vertices, varray, first, corners, weighting, threads, normals);
+  }
+
+  narray = varray;
+}
+
 /*!
 \brief Add a smooth triangle to the geometry.
 \param a, b, c Index of the vertices.
@@ -94,6 +266,7 @@ void Mesh::SmoothNormals()
 */
 void Mesh::AddSmoothTriangle(int a, int na, int b, int nb, int c, int nc)
 {
+  Invalidate();
   varray.push_back(a);
   narray.push_back(na);
   varray.push_back(b);
@@ -109,6 +282,7 @@ void Mesh::AddSmoothTriangle(int a, int na, int b, int nb, int c, int nc)
 */
 void Mesh::AddTriangle(int a, int b, int c, int n)
 {
+  Invalidate();
   varray.push_back(a);
   narray.push_back(n);
   varray.push_back(b);
@@ -153,7 +327,17 @@ Box Mesh::GetBox() const
   {
     return Box::Null;
   }
-  return Box(vertices);
+  return vertices.GetBox();
+}
+
+/*!
+\brief Change the storage of the vertices and normals, which are rounded when going to single precision.
+\param p Storage.
+*/
+void Mesh::SetPrecision(VertexArray::Precision p)
+{
+  vertices.SetPrecision(p);
+  normals.SetPrecision(p);
 }
 
 /*!
@@ -161,15 +345,16 @@ Box Mesh::GetBox() const
 
 The object has 8 vertices, 6 normals and 12 triangles.
 \param box The box.
+\param precision Storage of the vertices and normals.
 */
-Mesh::Mesh(const Box& box)
+Mesh::Mesh(const Box& box, VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
   // Vertices
   vertices.resize(8);
 
   for (int i = 0; i < 8; i++)
   {
-    vertices[i] = box.Vertex(i);
+    vertices.Set(i, box.Vertex(i));
   }
 
   // Normals
@@ -203,7 +388,7 @@ Mesh::Mesh(const Box& box)
   AddTriangle(6, 7, 2, 3);
 }
 
-Mesh::Mesh(const Disk& disk, int div)
+Mesh::Mesh(const Disk& disk, int div, VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
     float alpha;
     float step = 2.0 * M_PI / (div);
@@ -220,7 +405,7 @@ Mesh::Mesh(const Disk& disk, int div)
     }
 }
 
-Mesh::Mesh(const Sphere& sphere, int div)
+Mesh::Mesh(const Sphere& sphere, int div, VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
     double radius = sphere.getRadius();
     vertices.push_back(Vector(0, radius, 0));
@@ -279,7 +464,7 @@ Mesh::Mesh(const Sphere& sphere, int div)
     AddTriangle(vertices.size() - 1, vertices.size() - 1 - div, vertices.size() - 2, vertices.size() - 1 - div);
 }
 
-Mesh::Mesh(const Cylindre& cylindre, int div) {
+Mesh::Mesh(const Cylindre& cylindre, int div, VertexArray::Precision precision) :vertices(precision), normals(precision) {
     float alpha;
     float step = 2.0 * M_PI / (div);
     double r = cylindre.getRadius();
@@ -316,7 +501,7 @@ Mesh::Mesh(const Cylindre& cylindre, int div) {
 }
 
 
-Mesh::Mesh(const Tore& tore, int divR, int divT)
+Mesh::Mesh(const Tore& tore, int divR, int divT, VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
 
     for (float i = 0; i < divR; i++) {
@@ -344,7 +529,7 @@ Mesh::Mesh(const Tore& tore, int divR, int divT)
     }
 }
 
-Mesh::Mesh(const Capsule& capsule, int div)
+Mesh::Mesh(const Capsule& capsule, int div, VertexArray::Precision precision) :vertices(precision), normals(precision)
 {
     vertices.resize(1);
     float alpha;
@@ -403,7 +588,7 @@ Mesh::Mesh(const Capsule& capsule, int div)
     }
 }
 
-Mesh::Mesh(HeightField hf) {
+Mesh::Mesh(HeightField hf, VertexArray::Precision precision) :vertices(precision), normals(precision) {
     for (int i = 0; i <= hf.getM(); i++) {
         for (int j = 0; j <= hf.getN(); j++) {
             vertices.push_back(Vector(i, j, hf.getHeight(i,j)));
@@ -430,32 +615,25 @@ Mesh::Mesh(HeightField hf) {
 */
 void Mesh::Scale(double s)
 {
-    for (int i = 0; i < vertices.size(); i++)
-    {
-        vertices[i] *= s;
-    }
+    vertices.Scale(s);
 
     if (s < 0.0)
     {
-        for (int i = 0; i < normals.size(); i++)
-        {
-            normals[i] = -normals[i];
-        }
+        normals.Negate();
     }
 }
 
 void Mesh::Translation(float x, float y, float z) {
-    for (int i = 0; i < vertices.size(); i++)
-    {
-        vertices[i] += Vector(x,y,z);
-    }
+    vertices.Translate(Vector(x,y,z));
 }
 
 void Mesh::SphereWarp(int h) {
     for (int i = 0; i < vertices.size(); i++)
     {
         if (Norm(Vector(h)) - Norm(vertices[i]) <= 0) {
-            vertices[i] *= Vector(h);
+            Vector p = vertices[i];
+            p *= Vector(h);
+            vertices.Set(i, p);
         }
     }
 }
@@ -463,7 +641,9 @@ void Mesh::SphereWarp(int h) {
 void Mesh::modifyHeight(int x, int y, int h) {
     for (int i = 0; i < vertices.size(); ++i) {
         if (vertices[i][0] == x && vertices[i][1] == y) {
-            vertices[i][2] = h;
+            Vector p = vertices[i];
+            p[2] = h;
+            vertices.Set(i, p);
             break;
         }
     }
@@ -491,14 +671,8 @@ void Mesh::RotaionX(double deg) {
     m.tab[1][2] = sin(rad);
     m.tab[2][1] = -sin(rad);
 
-    for (int i = 0; i < vertices.size(); i++)
-    {
-        vertices[i] = m * vertices[i];
-    }
-    for (int i = 0; i < normals.size(); i++)
-    {
-        normals[i] = m * normals[i];
-    }
+    vertices.Transform(m);
+    normals.Transform(m);
 }
 void Mesh::RotaionY(double deg) {
     double rad = Math::DegreeToRadian(deg);
@@ -509,14 +683,8 @@ void Mesh::RotaionY(double deg) {
     m.tab[2][0] = sin(rad);
     m.tab[0][2] = -sin(rad);
 
-    for (int i = 0; i < vertices.size(); i++)
-    {
-        vertices[i] = m * vertices[i];
-    }
-    for (int i = 0; i < normals.size(); i++)
-    {
-        normals[i] = m * normals[i];
-    }
+    vertices.Transform(m);
+    normals.Transform(m);
 }
 void Mesh::RotaionZ(double deg) {
     double rad = Math::DegreeToRadian(deg);
@@ -527,17 +695,12 @@ void Mesh::RotaionZ(double deg) {
     m.tab[0][1] = sin(rad);
     m.tab[1][0] = -sin(rad);
 
-    for (int i = 0; i < vertices.size(); i++)
-    {
-        vertices[i] = m * vertices[i];
-    }
-    for (int i = 0; i < normals.size(); i++)
-    {
-        normals[i] = m * normals[i];
-    }
+    vertices.Transform(m);
+    normals.Transform(m);
 }
 
 void Mesh::Merge(Mesh &m) {
+    Invalidate();
     for (int i = 0; i < m.varray.size(); i++)
     {
         varray.push_back(vertices.size() + m.varray[i]);
@@ -546,17 +709,56 @@ void Mesh::Merge(Mesh &m) {
     {
         narray.push_back(normals.size() + m.narray[i]);
     }
-    for (int i = 0; i < m.vertices.size(); i++)
-    {
-        vertices.push_back(m.vertices[i]);
-    }
-    for (int i = 0; i < m.normals.size(); i++)
-    {
-        normals.push_back(m.normals[i]);
-    }
+    vertices.Append(m.vertices);
+    normals.Append(m.normals);
 
 }
 
+/*!
+\brief Resize the arrays of vertices and triangles.
+
+Added vertices and triangles are null, and should be set with SetVertex() and SetTriangle().
+\param nv Number of vertices.
+\param nt Number of triangles.
+*/
+void Mesh::Resize(int nv, int nt)
+{
+  Invalidate();
+  vertices.resize(nv);
+  normals.resize(nv);
+  varray.resize(3 * nt, 0);
+  narray.resize(3 * nt, 0);
+}
+
+/*!
+\brief Set a vertex and its normal.
+
+The mesh should have one normal per vertex, with the same vertex and normal indexes, as the meshes
+created by AnalyticScalarField::Polygonize().
+\param i Index.
+\param p Vertex.
+\param n Normal.
+*/
+void Mesh::SetVertex(int i, const Vector& p, const Vector& n)
+{
+  vertices.Set(i, p);
+  normals.Set(i, n);
+}
+
+/*!
+\brief Set the vertex indexes of a triangle, which are also its normal indexes.
+\sa Mesh::SetVertex()
+\param t Triangle index.
+\param a,b,c Vertex indexes.
+*/
+void Mesh::SetTriangle(int t, int a, int b, int c)
+{
+  Invalidate();
+  varray[3 * t] = narray[3 * t] = a;
+  varray[3 * t + 1] = narray[3 * t + 1] = b;
+  varray[3 * t + 2] = narray[3 * t + 2] = c;
+}
+
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 #include <QtCore/QRegularExpression>
@@ -568,6 +770,7 @@ void Mesh::Merge(Mesh &m) {
 */
 void Mesh::Load(const QString& filename)
 {
+  Invalidate();
   vertices.clear();
   normals.clear();
   varray.clear();
@@ -623,9 +826,15 @@ void Mesh::SaveObj(const QString& url, const QString& meshName) const
   QTextStream out(&data);
   out << "g " << meshName << Qt::endl;
   for (int i = 0; i < vertices.size(); i++)
-    out << "v " << vertices.at(i)[0] << " " << vertices.at(i)[1] << " " << vertices.at(i)[2] << QString('\n');
+  {
+    const Vector p = vertices[i];
+    out << "v " << p[0] << " " << p[1] << " " << p[2] << QString('\n');
+  }
   for (int i = 0; i < normals.size(); i++)
-    out << "vn " << normals.at(i)[0] << " " << normals.at(i)[1] << " " << normals.at(i)[2] << QString('\n');
+  {
+    const Vector n = normals[i];
+    out << "vn " << n[0] << " " << n[1] << " " << n[2] << QString('\n');
+  }
   for (int i = 0; i < varray.size(); i += 3)
   {
     out << "f " << varray.at(i) + 1 << "//" << narray.at(i) + 1 << " "
@@ -0,0 +1,359 @@
+// Signed distance fields of primitives
+
+// Self include
+#include "primitive-fields.h"
+
+#include <limits>
+
+/*!
+\class ToreField primitive-fields.h
+\brief Exact signed distance field of a Tore, whose central circle lies in the xy plane and is centered at the origin.
+
+As every signed distance field of this file, the field is negative inside, has an analytic gradient and a Lipschitz constant of 1,
+so that it can be polygonized over its tight bounding box and sphere traced with AnalyticScalarField::Intersect():
+
+\code
+ToreField tore(Tore(1.0, 0.25));
+Mesh mesh;
+tore.Polygonize(64, mesh, tore.GetBox());
+\endcode
+*/
+
+/*!
+\brief Create the signed distance field of a tore.
+\param tore The tore.
+*/
+ToreField::ToreField(const Tore& tore) :r(tore.getRadius()), t(tore.getThickness())
+{
+}
+
+/*!
+\brief Compute the signed distance to the tore.
+\param p Point.
+*/
+double ToreField::Value(const Vector& p) const
+{
+  const double x = sqrt(p[0] * p[0] + p[1] * p[1]) - r;
+  return sqrt(x * x + p[2] * p[2]) - t;
+}
+
+/*!
+\brief Compute the gradient of the signed distance.
+\param p Point.
+*/
+Vector ToreField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the tore and its analytic gradient.
+
+The gradient is the unit vector from the closest point of the central circle, it is set to an arbitrary unit vector where it is undefined.
+\param p Point.
+\param g Returned gradient.
+*/
+double ToreField::ValueGradient(const Vector& p, Vector& g) const
+{
+  const double l = sqrt(p[0] * p[0] + p[1] * p[1]);
+  const Vector u = (l > 0.0) ? Vector(p[0] / l, p[1] / l, 0.0) : Vector::X;
+  const double x = l - r;
+  const double q = sqrt(x * x + p[2] * p[2]);
+  g = (q > 0.0) ? (x / q) * u + Vector(0.0, 0.0, p[2] / q) : u;
+  return q - t;
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double ToreField::Lipschitz() const
+{
+  return 1.0;
+}
+
+/*!
+\class CylindreField primitive-fields.h
+\brief Exact signed distance field of a capped Cylindre, whose axis is the y axis from -h to h.
+*/
+
+/*!
+\brief Create the signed distance field of a cylinder.
+\param cylindre The cylinder.
+*/
+CylindreField::CylindreField(const Cylindre& cylindre) :r(cylindre.getRadius()), h(cylindre.getHeight())
+{
+}
+
+/*!
+\brief Compute the signed distance to the cylinder.
+\param p Point.
+*/
+double CylindreField::Value(const Vector& p) const
+{
+  const double a = sqrt(p[0] * p[0] + p[2] * p[2]) - r;
+  const double b = fabs(p[1]) - h;
+  if (a > 0.0 || b > 0.0)
+  {
+    const double x = Math::Max(a, 0.0);
+    const double y = Math::Max(b, 0.0);
+    return sqrt(x * x + y * y);
+  }
+  return Math::Max(a, b);
+}
+
+/*!
+\brief Compute the gradient of the signed distance.
+\param p Point.
+*/
+Vector CylindreField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the cylinder and its analytic gradient.
+\param p Point.
+\param g Returned gradient.
+*/
+double CylindreField::ValueGradient(const Vector& p, Vector& g) const
+{
+  const double l = sqrt(p[0] * p[0] + p[2] * p[2]);
+  const Vector u = (l > 0.0) ? Vector(p[0] / l, 0.0, p[2] / l) : Vector::X;
+  const Vector v = (p[1] < 0.0) ? -Vector::Y : Vector::Y;
+  const double a = l - r;
+  const double b = fabs(p[1]) - h;
+  if (a > 0.0 || b > 0.0)
+  {
+    const double x = Math::Max(a, 0.0);
+    const double y = Math::Max(b, 0.0);
+    const double d = sqrt(x * x + y * y);
+    g = (x / d) * u + (y / d) * v;
+    return d;
+  }
+  // Inside, the closest point is on the side or on a cap
+  g = (a > b) ? u : v;
+  return Math::Max(a, b);
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double CylindreField::Lipschitz() const
+{
+  return 1.0;
+}
+
+/*!
+\class CapsuleField primitive-fields.h
+\brief Exact signed distance field of a Capsule, whose axis is the y axis from -h to h.
+*/
+
+/*!
+\brief Create the signed distance field of a capsule.
+\param capsule The capsule.
+*/
+CapsuleField::CapsuleField(const Capsule& capsule) :r(capsule.getRadius()), h(capsule.getHeight())
+{
+}
+
+/*!
+\brief Compute the signed distance to the capsule.
+\param p Point.
+*/
+double CapsuleField::Value(const Vector& p) const
+{
+  const double y = p[1] - Math::Clamp(p[1], -h, h);
+  return sqrt(p[0] * p[0] + y * y + p[2] * p[2]) - r;
+}
+
+/*!
+\brief Compute the gradient of the signed distance.
+\param p Point.
+*/
+Vector CapsuleField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the capsule and its analytic gradient.
+
+The gradient is the unit vector from the closest point of the axis, it is set to the x axis on the axis.
+\param p Point.
+\param g Returned gradient.
+*/
+double CapsuleField::ValueGradient(const Vector& p, Vector& g) const
+{
+  const Vector q(p[0], p[1] - Math::Clamp(p[1], -h, h), p[2]);
+  const double l = Norm(q);
+  g = (l > 0.0) ? q / l : Vector::X;
+  return l - r;
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double CapsuleField::Lipschitz() const
+{
+  return 1.0;
+}
+
+/*!
+\class DiskField primitive-fields.h
+\brief Exact signed distance field of a Disk lying in the xz plane, offset by a thickness.
+
+A disk has no volume, therefore the field is the distance to the disk minus the thickness, which defines a disk with rounded rims.
+*/
+
+/*!
+\brief Create the signed distance field of a disk.
+\param disk The disk.
+\param thickness Thickness, the surface is the disk itself if null.
+*/
+DiskField::DiskField(const Disk& disk, double thickness) :c(disk.getCenter()), r(disk.getRadius()), e(thickness)
+{
+}
+
+/*!
+\brief Compute the signed distance to the disk.
+\param p Point.
+*/
+double DiskField::Value(const Vector& p) const
+{
+  const Vector q = p - c;
+  const double x = Math::Max(sqrt(q[0] * q[0] + q[2] * q[2]) - r, 0.0);
+  return sqrt(x * x + q[1] * q[1]) - e;
+}
+
+/*!
+\brief Compute the gradient of the signed distance.
+\param p Point.
+*/
+Vector DiskField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the disk and its analytic gradient.
+
+The gradient is the unit vector from the closest point of the disk, it is set to the y axis on the disk.
+\param p Point.
+\param g Returned gradient.
+*/
+double DiskField::ValueGradient(const Vector& p, Vector& g) const
+{
+  const Vector q = p - c;
+  const double l = sqrt(q[0] * q[0] + q[2] * q[2]);
+  const double x = Math::Max(l - r, 0.0);
+  const double d = sqrt(x * x + q[1] * q[1]);
+  if (d > 0.0)
+  {
+    g = (l > 0.0) ? Vector(x * q[0] / (l * d), q[1] / d, x * q[2] / (l * d)) : Vector(0.0, q[1] / d, 0.0);
+  }
+  else
+  {
+    g = Vector::Y;
+  }
+  return d - e;
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double DiskField::Lipschitz() const
+{
+  return 1.0;
+}
+
+/*!
+\class BoxField primitive-fields.h
+\brief Exact signed distance field of an axis aligned Box.
+*/
+
+/*!
+\brief Create the signed distance field of a box.
+\param box The box.
+*/
+BoxField::BoxField(const Box& box) :box(box)
+{
+}
+
+/*!
+\brief Compute the signed distance to the box.
+\param p Point.
+*/
+double BoxField::Value(const Vector& p) const
+{
+  double outside = 0.0;
+  double inside = -std::numeric_limits<double>::infinity();
+  for (int i = 0; i < 3; i++)
+  {
+    const double q = Math::Max(box[0][i] - p[i], p[i] - box[1][i]);
+    outside += Math::Max(q, 0.0) * Math::Max(q, 0.0);
+    inside = Math::Max(inside, q);
+  }
+  return (inside > 0.0) ? sqrt(outside) : inside;
+}
+
+/*!
+\brief Compute the gradient of the signed distance.
+\param p Point.
+*/
+Vector BoxField::Gradient(const Vector& p) const
+{
+  Vector g;
+  ValueGradient(p, g);
+  return g;
+}
+
+/*!
+\brief Compute the signed distance to the box and its analytic gradient.
+
+Inside, the gradient is the normal of the closest face.
+\param p Point.
+\param g Returned gradient.
+*/
+double BoxField::ValueGradient(const Vector& p, Vector& g) const
+{
+  Vector q, s;
+  int axis = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    const double a = box[0][i] - p[i];
+    const double b = p[i] - box[1][i];
+    q[i] = Math::Max(a, b);
+    s[i] = (a > b) ? -1.0 : 1.0;
+    if (q[i] > q[axis])
+    {
+      axis = i;
+    }
+  }
+
+  if (q[axis] > 0.0)
+  {
+    const Vector o(Math::Max(q[0], 0.0), Math::Max(q[1], 0.0), Math::Max(q[2], 0.0));
+    const double d = Norm(o);
+    g = Vector(s[0] * o[0] / d, s[1] * o[1] / d, s[2] * o[2] / d);
+    return d;
+  }
+  g = Vector::Null;
+  g[axis] = s[axis];
+  return q[axis];
+}
+
+/*!
+\brief Lipschitz bound of the signed distance, which is 1.
+*/
+double BoxField::Lipschitz() const
+{
+  return 1.0;
+}
@@ -1,11 +1,14 @@
 #include "qte.h"
 #
 #include "implicits.h"
+#include "mesh-bvh.h"
 #include "ui_interface.h"
 #include "../tore.h"
 #include "../capsule.h"
 
-MainWindow::MainWindow() : QMainWindow(), uiw(new Ui::Assets)
+#include <QtWidgets/QStatusBar>
+
+MainWindow::MainWindow() : QMainWindow(), uiw(new Ui::Assets), implicit(nullptr), bvh(nullptr)
 {
 	// Chargement de l'interface
     uiw->setupUi(this);
@@ -26,6 +29,8 @@ MainWindow::MainWindow() : QMainWindow(), uiw(new Ui::Assets)
 MainWindow::~MainWindow()
 {
 	delete meshWidget;
+	delete implicit;
+	delete bvh;
 }
 
 void MainWindow::CreateActions()
@@ -53,12 +58,48 @@ void MainWindow::CreateActions()
 	connect(meshWidget, SIGNAL(_signalEditSceneRight(const Ray&)), this, SLOT(editingSceneRight(const Ray&)));
 }
 
-void MainWindow::editingSceneLeft(const Ray&)
+void MainWindow::editingSceneLeft(const Ray& ray)
 {
+  if (implicit == nullptr)
+  {
+    editingSceneRight(ray);
+    return;
+  }
+
+  // Pick the implicit surface directly, the box of the mesh is enlarged to contain the surface
+  Box box = meshColor.GetBox();
+  box = Box(box[0] - 0.1 * box.Diagonal(), box[1] + 0.1 * box.Diagonal());
+  double t;
+  if (implicit->Intersect(ray, box, t))
+  {
+    Vector p = ray(t);
+    statusBar()->showMessage(QString("Implicit surface at %1 %2 %3").arg(p[0]).arg(p[1]).arg(p[2]));
+  }
+  else
+  {
+    statusBar()->clearMessage();
+  }
 }
 
-void MainWindow::editingSceneRight(const Ray&)
+void MainWindow::editingSceneRight(const Ray& ray)
 {
+  if (bvh == nullptr)
+  {
+    bvh = new MeshBVH(meshColor);
+  }
+
+  // Pick the triangles of the mesh
+  double t;
+  int triangle;
+  if (bvh->Intersect(ray, t, triangle))
+  {
+    Vector p = ray(t);
+    statusBar()->showMessage(QString("Triangle %1 at %2 %3 %4").arg(triangle).arg(p[0]).arg(p[1]).arg(p[2]));
+  }
+  else
+  {
+    statusBar()->clearMessage();
+  }
 }
 
 void MainWindow::BoxMeshExample()
@@ -75,10 +116,25 @@ void MainWindow::BoxMeshExample()
 
 void MainWindow::SphereImplicitExample()
 {
-  AnalyticScalarField implicit;
+  AnalyticScalarField* field = new AnalyticScalarField;
 
   Mesh implicitMesh;
-  implicit.Polygonize(31, implicitMesh, Box(2.0));
+  field->Polygonize(31, implicitMesh, Box(2.0));
+
+#ifdef TINYMESH_STATISTICS
+  const AnalyticScalarField::Statistics& stats = field->GetStatistics();
+  double time = 0.0;
+  for (double t : stats.slabs)
+    time += t;
+  meshWidget->SetStatistics(QStringList()
+    << "Samples:\t" + QString::number(stats.evaluations.classification)
+    << "Roots:\t" + QString::number(stats.evaluations.roots)
+    << "Normals:\t" + QString::number(stats.evaluations.normals)
+    << "Cells:\t" + QString::number(stats.cells)
+    << "Iterations:\t" + QString::number(stats.iterations)
+    << "Polygonize:\t" + QString::number(time) + "ms"
+    << "Memory:\t" + QString::number(stats.bytes / 1024) + "KB");
+#endif
 
   std::vector<Color> cols;
   cols.resize(implicitMesh.Vertexes());
@@ -86,7 +142,7 @@ void MainWindow::SphereImplicitExample()
     cols[i] = Color(0.8, 0.8, 0.8);
 
   meshColor = MeshColor(implicitMesh, cols, implicitMesh.VertexIndexes());
-  UpdateGeometry();
+  UpdateGeometry(field);
 }
 
 void MainWindow::DisqueMeshExample()
@@ -284,10 +340,18 @@ void MainWindow::SceneExample()
 
 
 
-void MainWindow::UpdateGeometry()
+void MainWindow::UpdateGeometry(AnalyticScalarField* field)
 {
+	delete implicit;
+	implicit = field;
+	delete bvh;
+	bvh = nullptr;
+
 	meshWidget->ClearAll();
 	meshWidget->AddMesh("BoxMesh", meshColor);
+	// Only the implicit examples report statistics
+	if (field == nullptr)
+		meshWidget->SetStatistics(QStringList());
 
     uiw->lineEdit->setText(QString::number(meshColor.Vertexes()));
     uiw->lineEdit_2->setText(QString::number(meshColor.Triangles()));
@@ -0,0 +1,542 @@
+// Packet ray triangle intersection kernels
+
+// Self include
+#include "ray-packet.h"
+
+#include <cstring>
+#include <utility>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*!
+\class WatertightRay ray-packet.h
+\brief A ray prepared for the watertight ray triangle intersection test of Woop, Benthin and Wald.
+
+The axes are permuted so that the dominant axis of the direction becomes the last one, and the vertices of the triangles
+are sheared so that the ray becomes the last axis. The test then reduces to the signs of three 2D edge functions: an edge shared by two
+triangles is evaluated with the same operations for both, so that a ray never slips through the edges or the vertices of a closed mesh.
+Edge functions that vanish in single precision are recomputed in double precision, where the products of floats are exact.
+*/
+
+/*!
+\brief Prepare a ray for the watertight test.
+\param ray The ray.
+*/
+WatertightRay::WatertightRay(const Ray& ray)
+{
+  const Vector& d = ray.Direction();
+  kz = 0;
+  if (fabs(d[1]) > fabs(d[kz]))
+  {
+    kz = 1;
+  }
+  if (fabs(d[2]) > fabs(d[kz]))
+  {
+    kz = 2;
+  }
+  kx = (kz + 1) % 3;
+  ky = (kx + 1) % 3;
+  // Preserve the winding of the triangles
+  if (d[kz] < 0.0)
+  {
+    std::swap(kx, ky);
+  }
+  sx = float(d[kx] / d[kz]);
+  sy = float(d[ky] / d[kz]);
+  sz = float(1.0 / d[kz]);
+
+  const Vector& p = ray.Origin();
+  o[0] = float(p[0]);
+  o[1] = float(p[1]);
+  o[2] = float(p[2]);
+}
+
+/*
+Lanes of floats with the operations of the kernels, lanes of masks have all their bits set.
+The generic version is written with plain loops, the four and eight lanes versions map to SSE and AVX registers.
+*/
+template<int N>
+struct Lanes
+{
+  float v[N];
+
+  static Lanes Set(float x)
+  {
+    Lanes r;
+    for (int i = 0; i < N; i++)
+    {
+      r.v[i] = x;
+    }
+    return r;
+  }
+  static Lanes Load(const float* p)
+  {
+    Lanes r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  static Lanes Mask(const int* p)
+  {
+    Lanes r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  void Store(float* p) const
+  {
+    memcpy(p, v, sizeof(v));
+  }
+  int Bits() const
+  {
+    unsigned int b[N];
+    memcpy(b, v, sizeof(v));
+    int m = 0;
+    for (int i = 0; i < N; i++)
+    {
+      m |= int(b[i] >> 31) << i;
+    }
+    return m;
+  }
+
+  template<typename F>
+  static Lanes Map(const Lanes& a, const Lanes& b, F f)
+  {
+    Lanes r;
+    for (int i = 0; i < N; i++)
+    {
+      r.v[i] = f(a.v[i], b.v[i]);
+    }
+    return r;
+  }
+  template<typename F>
+  static Lanes Test(const Lanes& a, const Lanes& b, F f)
+  {
+    unsigned int r[N];
+    for (int i = 0; i < N; i++)
+    {
+      r[i] = f(a.v[i], b.v[i]) ? 0xffffffffu : 0u;
+    }
+    Lanes m;
+    memcpy(m.v, r, sizeof(r));
+    return m;
+  }
+  template<typename F>
+  static Lanes Logic(const Lanes& a, const Lanes& b, F f)
+  {
+    unsigned int x[N], y[N];
+    memcpy(x, a.v, sizeof(x));
+    memcpy(y, b.v, sizeof(y));
+    for (int i = 0; i < N; i++)
+    {
+      x[i] = f(x[i], y[i]);
+    }
+    Lanes r;
+    memcpy(r.v, x, sizeof(x));
+    return r;
+  }
+
+  friend Lanes operator+(const Lanes& a, const Lanes& b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+  friend Lanes operator-(const Lanes& a, const Lanes& b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+  friend Lanes operator*(const Lanes& a, const Lanes& b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+  friend Lanes operator/(const Lanes& a, const Lanes& b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+  friend Lanes operator<(const Lanes& a, const Lanes& b) { return Test(a, b, [](float x, float y) { return x < y; }); }
+  friend Lanes operator>(const Lanes& a, const Lanes& b) { return Test(a, b, [](float x, float y) { return x > y; }); }
+  friend Lanes operator==(const Lanes& a, const Lanes& b) { return Test(a, b, [](float x, float y) { return x == y; }); }
+  friend Lanes operator&(const Lanes& a, const Lanes& b) { return Logic(a, b, [](unsigned int x, unsigned int y) { return x & y; }); }
+  friend Lanes operator|(const Lanes& a, const Lanes& b) { return Logic(a, b, [](unsigned int x, unsigned int y) { return x | y; }); }
+  friend Lanes AndNot(const Lanes& a, const Lanes& b) { return Logic(a, b, [](unsigned int x, unsigned int y) { return ~x & y; }); }
+  //! Select the lanes of a where the mask is set, and those of b elsewhere.
+  friend Lanes Select(const Lanes& m, const Lanes& a, const Lanes& b) { return (m & a) | AndNot(m, b); }
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+template<>
+struct Lanes<4>
+{
+  __m128 v;
+
+  Lanes() {}
+  Lanes(__m128 v) :v(v) {}
+
+  static Lanes Set(float x) { return _mm_set1_ps(x); }
+  static Lanes Load(const float* p) { return _mm_loadu_ps(p); }
+  static Lanes Mask(const int* p) { return _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)p)); }
+  void Store(float* p) const { _mm_storeu_ps(p, v); }
+  int Bits() const { return _mm_movemask_ps(v); }
+
+  friend Lanes operator+(const Lanes& a, const Lanes& b) { return _mm_add_ps(a.v, b.v); }
+  friend Lanes operator-(const Lanes& a, const Lanes& b) { return _mm_sub_ps(a.v, b.v); }
+  friend Lanes operator*(const Lanes& a, const Lanes& b) { return _mm_mul_ps(a.v, b.v); }
+  friend Lanes operator/(const Lanes& a, const Lanes& b) { return _mm_div_ps(a.v, b.v); }
+  friend Lanes operator<(const Lanes& a, const Lanes& b) { return _mm_cmplt_ps(a.v, b.v); }
+  friend Lanes operator>(const Lanes& a, const Lanes& b) { return _mm_cmpgt_ps(a.v, b.v); }
+  friend Lanes operator==(const Lanes& a, const Lanes& b) { return _mm_cmpeq_ps(a.v, b.v); }
+  friend Lanes operator&(const Lanes& a, const Lanes& b) { return _mm_and_ps(a.v, b.v); }
+  friend Lanes operator|(const Lanes& a, const Lanes& b) { return _mm_or_ps(a.v, b.v); }
+  friend Lanes AndNot(const Lanes& a, const Lanes& b) { return _mm_andnot_ps(a.v, b.v); }
+  friend Lanes Select(const Lanes& m, const Lanes& a, const Lanes& b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+};
+#endif
+
+#if defined(__AVX__)
+template<>
+struct Lanes<8>
+{
+  __m256 v;
+
+  Lanes() {}
+  Lanes(__m256 v) :v(v) {}
+
+  static Lanes Set(float x) { return _mm256_set1_ps(x); }
+  static Lanes Load(const float* p) { return _mm256_loadu_ps(p); }
+  static Lanes Mask(const int* p) { return _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)p)); }
+  void Store(float* p) const { _mm256_storeu_ps(p, v); }
+  int Bits() const { return _mm256_movemask_ps(v); }
+
+  friend Lanes operator+(const Lanes& a, const Lanes& b) { return _mm256_add_ps(a.v, b.v); }
+  friend Lanes operator-(const Lanes& a, const Lanes& b) { return _mm256_sub_ps(a.v, b.v); }
+  friend Lanes operator*(const Lanes& a, const Lanes& b) { return _mm256_mul_ps(a.v, b.v); }
+  friend Lanes operator/(const Lanes& a, const Lanes& b) { return _mm256_div_ps(a.v, b.v); }
+  friend Lanes operator<(const Lanes& a, const Lanes& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+  friend Lanes operator>(const Lanes& a, const Lanes& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+  friend Lanes operator==(const Lanes& a, const Lanes& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+  friend Lanes operator&(const Lanes& a, const Lanes& b) { return _mm256_and_ps(a.v, b.v); }
+  friend Lanes operator|(const Lanes& a, const Lanes& b) { return _mm256_or_ps(a.v, b.v); }
+  friend Lanes AndNot(const Lanes& a, const Lanes& b) { return _mm256_andnot_ps(a.v, b.v); }
+  friend Lanes Select(const Lanes& m, const Lanes& a, const Lanes& b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+};
+#endif
+
+/*!
+\brief Mask of the first lanes.
+\param n Number of lanes.
+*/
+template<int N>
+static Lanes<N> First(int n)
+{
+  int m[N];
+  for (int i = 0; i < N; i++)
+  {
+    m[i] = (i < n) ? -1 : 0;
+  }
+  return Lanes<N>::Mask(m);
+}
+
+/*!
+\brief Watertight intersection test, given the vertices of the triangles sheared in the space of the rays.
+\param x, y, z Sheared coordinates of the three vertices.
+\param tmax Upper bound of the distance along the rays.
+\param valid Mask of the lanes to test.
+\param t, u, v Returned distance and barycentric coordinates of the second and third vertices.
+\return Mask of the lanes that intersect.
+*/
+template<int N>
+static Lanes<N> Watertight(const Lanes<N>* x, const Lanes<N>* y, const Lanes<N>* z, const Lanes<N>& tmax, const Lanes<N>& valid, Lanes<N>& t, Lanes<N>& u, Lanes<N>& v)
+{
+  typedef Lanes<N> L;
+  const L zero = L::Set(0.0f);
+
+  // Scaled barycentric coordinates
+  L e[3] = { x[2] * y[1] - y[2] * x[1], x[0] * y[2] - y[0] * x[2], x[1] * y[0] - y[1] * x[0] };
+
+  // Edge functions that vanish are recomputed in double precision, where the products are exact
+  const int zeros = (valid & ((e[0] == zero) | (e[1] == zero) | (e[2] == zero))).Bits();
+  if (zeros != 0)
+  {
+    float xs[3][N], ys[3][N], es[3][N];
+    for (int j = 0; j < 3; j++)
+    {
+      x[j].Store(xs[j]);
+      y[j].Store(ys[j]);
+      e[j].Store(es[j]);
+    }
+    for (int i = 0; i < N; i++)
+    {
+      if (zeros & (1 << i))
+      {
+        es[0][i] = float(double(xs[2][i]) * double(ys[1][i]) - double(ys[2][i]) * double(xs[1][i]));
+        es[1][i] = float(double(xs[0][i]) * double(ys[2][i]) - double(ys[0][i]) * double(xs[2][i]));
+        es[2][i] = float(double(xs[1][i]) * double(ys[0][i]) - double(ys[1][i]) * double(xs[0][i]));
+      }
+    }
+    for (int j = 0; j < 3; j++)
+    {
+      e[j] = L::Load(es[j]);
+    }
+  }
+
+  // The ray misses if the edge functions have different signs
+  const L negative = (e[0] < zero) | (e[1] < zero) | (e[2] < zero);
+  const L positive = (e[0] > zero) | (e[1] > zero) | (e[2] > zero);
+
+  const L det = e[0] + e[1] + e[2];
+  const L inv = L::Set(1.0f) / det;
+  t = (e[0] * z[0] + e[1] * z[1] + e[2] * z[2]) * inv;
+  u = e[1] * inv;
+  v = e[2] * inv;
+
+  return AndNot(negative & positive, valid & ((det < zero) | (det > zero)) & (t > zero) & (t < tmax));
+}
+
+/*!
+\class TrianglePacket ray-packet.h
+\brief A packet of four or eight triangles stored in structure of arrays layout, intersected by a single ray at once.
+
+This is the kernel of a hierarchy whose leaves store a few triangles, and of the shadow and ambient occlusion rays
+that only need to know whether something is hit.
+
+\code
+TrianglePacket8 packet;
+for (int i = 0; i < 8; i++)
+{
+  packet.Set(i, mesh.GetTriangle(i));
+}
+float t, u, v;
+int i = packet.Intersect(WatertightRay(ray), t, u, v);
+\endcode
+
+The eight lanes version uses AVX registers when available, and the four lanes version uses SSE registers.
+*/
+
+/*!
+\brief Create an empty packet.
+*/
+template<int N>
+TrianglePacket<N>::TrianglePacket() :count(0)
+{
+  memset(p, 0, sizeof(p));
+}
+
+/*!
+\brief Set a triangle of the packet, the number of triangles is extended if needed.
+\param i Lane.
+\param a, b, c Vertices.
+*/
+template<int N>
+void TrianglePacket<N>::Set(int i, const Vector& a, const Vector& b, const Vector& c)
+{
+  const Vector* q[3] = { &a, &b, &c };
+  for (int j = 0; j < 3; j++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      p[j][k][i] = float((*q[j])[k]);
+    }
+  }
+  count = Math::Max(count, i + 1);
+}
+
+/*!
+\brief Set a triangle of the packet.
+\param i Lane.
+\param triangle The triangle.
+*/
+template<int N>
+void TrianglePacket<N>::Set(int i, const Triangle& triangle)
+{
+  Set(i, triangle[0], triangle[1], triangle[2]);
+}
+
+/*!
+\brief Shear the vertices of the triangles of a packet in the space of a ray.
+*/
+template<int N>
+static void Shear(const float (&p)[3][3][N], const WatertightRay& ray, Lanes<N>* x, Lanes<N>* y, Lanes<N>* z)
+{
+  typedef Lanes<N> L;
+  const L ox = L::Set(ray.o[ray.kx]);
+  const L oy = L::Set(ray.o[ray.ky]);
+  const L oz = L::Set(ray.o[ray.kz]);
+  const L sx = L::Set(ray.sx);
+  const L sy = L::Set(ray.sy);
+  const L sz = L::Set(ray.sz);
+  for (int j = 0; j < 3; j++)
+  {
+    const L pz = L::Load(p[j][ray.kz]) - oz;
+    x[j] = (L::Load(p[j][ray.kx]) - ox) - sx * pz;
+    y[j] = (L::Load(p[j][ray.ky]) - oy) - sy * pz;
+    z[j] = sz * pz;
+  }
+}
+
+/*!
+\brief Compute the closest intersection between a ray and the triangles of the packet.
+\param ray The ray.
+\param t Returned distance along the ray, scaled by the norm of its direction.
+\param u, v Returned barycentric coordinates, as for Triangle::Vertex().
+\param tmax Upper bound of the distance.
+\return Lane of the intersected triangle, -1 if none.
+*/
+template<int N>
+int TrianglePacket<N>::Intersect(const WatertightRay& ray, float& t, float& u, float& v, float tmax) const
+{
+  typedef Lanes<N> L;
+  L x[3], y[3], z[3];
+  Shear(p, ray, x, y, z);
+
+  L lt, lu, lv;
+  const int hits = Watertight(x, y, z, L::Set(tmax), First<N>(count), lt, lu, lv).Bits();
+  if (hits == 0)
+  {
+    return -1;
+  }
+
+  float ts[N], us[N], vs[N];
+  lt.Store(ts);
+  lu.Store(us);
+  lv.Store(vs);
+  int lane = -1;
+  for (int i = 0; i < N; i++)
+  {
+    if ((hits & (1 << i)) && (lane < 0 || ts[i] < ts[lane]))
+    {
+      lane = i;
+    }
+  }
+  t = ts[lane];
+  u = us[lane];
+  v = vs[lane];
+  return lane;
+}
+
+/*!
+\brief Check whether a ray intersects any triangle of the packet.
+\param ray The ray.
+\param tmax Upper bound of the distance.
+*/
+template<int N>
+bool TrianglePacket<N>::Occluded(const WatertightRay& ray, float tmax) const
+{
+  typedef Lanes<N> L;
+  L x[3], y[3], z[3];
+  Shear(p, ray, x, y, z);
+
+  L lt, lu, lv;
+  return Watertight(x, y, z, L::Set(tmax), First<N>(count), lt, lu, lv).Bits() != 0;
+}
+
+/*!
+\class RayPacket ray-packet.h
+\brief A packet of four or eight coherent rays stored in structure of arrays layout, intersected with a single triangle at once.
+
+This is the kernel of the rendering of tiles of pixels, whose rays are generated with Camera::PixelToRay(). The distances are updated
+in place, which makes it easy to find the closest intersections with a set of triangles:
+
+\code
+RayPacket4 packet;
+float t[4], u[4], v[4];
+for (int i = 0; i < 4; i++)
+{
+  packet.Set(i, camera.PixelToRay(x + i, y, w, h));
+  t[i] = std::numeric_limits<float>::infinity();
+}
+for (int j = 0; j < mesh.Triangles(); j++)
+{
+  int hits = packet.Intersect(mesh.GetTriangle(j), t, u, v);
+}
+\endcode
+
+The rays need not share their dominant axis, the permutation of the axes is applied lane by lane with masks.
+*/
+
+/*!
+\brief Create an empty packet.
+*/
+template<int N>
+RayPacket<N>::RayPacket() :count(0)
+{
+  memset(o, 0, sizeof(o));
+  memset(s, 0, sizeof(s));
+  memset(k, 0, sizeof(k));
+}
+
+/*!
+\brief Set a ray of the packet, the number of rays is extended if needed.
+\param i Lane.
+\param ray The ray.
+*/
+template<int N>
+void RayPacket<N>::Set(int i, const Ray& ray)
+{
+  const WatertightRay r(ray);
+  const int a[3] = { r.kx, r.ky, r.kz };
+  for (int j = 0; j < 3; j++)
+  {
+    o[j][i] = r.o[j];
+    k[j][0][i] = (a[j] == 1) ? -1 : 0;
+    k[j][1][i] = (a[j] == 2) ? -1 : 0;
+  }
+  s[0][i] = r.sx;
+  s[1][i] = r.sy;
+  s[2][i] = r.sz;
+  count = Math::Max(count, i + 1);
+}
+
+/*!
+\brief Intersect the rays of the packet with a triangle, and update the closest intersections.
+\param a, b, c Vertices of the triangle.
+\param t Distances along the rays, used as upper bounds and updated where the triangle is closer.
+\param u, v Barycentric coordinates, updated where the triangle is closer.
+\return Mask of the rays that intersect the triangle closer than before.
+*/
+template<int N>
+int RayPacket<N>::Intersect(const Vector& a, const Vector& b, const Vector& c, float* t, float* u, float* v) const
+{
+  typedef Lanes<N> L;
+  const Vector* q[3] = { &a, &b, &c };
+
+  const L m[3][2] = { { L::Mask(k[0][0]), L::Mask(k[0][1]) }, { L::Mask(k[1][0]), L::Mask(k[1][1]) }, { L::Mask(k[2][0]), L::Mask(k[2][1]) } };
+  const L sx = L::Load(s[0]);
+  const L sy = L::Load(s[1]);
+  const L sz = L::Load(s[2]);
+
+  L x[3], y[3], z[3];
+  for (int j = 0; j < 3; j++)
+  {
+    L d[3];
+    for (int i = 0; i < 3; i++)
+    {
+      d[i] = L::Set(float((*q[j])[i])) - L::Load(o[i]);
+    }
+    // Permute the axes lane by lane
+    const L px = Select(m[0][1], d[2], Select(m[0][0], d[1], d[0]));
+    const L py = Select(m[1][1], d[2], Select(m[1][0], d[1], d[0]));
+    const L pz = Select(m[2][1], d[2], Select(m[2][0], d[1], d[0]));
+    x[j] = px - sx * pz;
+    y[j] = py - sy * pz;
+    z[j] = sz * pz;
+  }
+
+  const L tmax = L::Load(t);
+  L lt, lu, lv;
+  const L hit = Watertight(x, y, z, tmax, First<N>(count), lt, lu, lv);
+  const int hits = hit.Bits();
+  if (hits != 0)
+  {
+    Select(hit, lt, tmax).Store(t);
+    Select(hit, lu, L::Load(u)).Store(u);
+    Select(hit, lv, L::Load(v)).Store(v);
+  }
+  return hits;
+}
+
+/*!
+\brief Intersect the rays of the packet with a triangle, and update the closest intersections.
+\param triangle The triangle.
+\param t Distances along the rays, used as upper bounds and updated where the triangle is closer.
+\param u, v Barycentric coordinates, updated where the triangle is closer.
+\return Mask of the rays that intersect the triangle closer than before.
+*/
+template<int N>
+int RayPacket<N>::Intersect(const Triangle& triangle, float* t, float* u, float* v) const
+{
+  return Intersect(triangle[0], triangle[1], triangle[2], t, u, v);
+}
+
+template class TrianglePacket<4>;
+template class TrianglePacket<8>;
+template class RayPacket<4>;
+template class RayPacket<8>;
@@ -0,0 +1,589 @@
+// Scalar grid
+
+// Self include
+#include "scalar-grid.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+\class ScalarGrid scalar-grid.h
+\brief A field function sampled once on a regular grid.
+
+The grid caches the values of a field function so that the surface can be extracted several times,
+at different iso-levels, in sub-boxes or with coarser strides, without evaluating the field again.
+Vertices on straddling edges are computed by linear interpolation and normals from the central differences
+of the grid values, therefore extraction is a pure table lookup:
+
+\code
+ImplicitBlend blend(a, b, 0.5);
+ScalarGrid grid(blend, Box(2.5), 128, 0);
+
+Mesh mesh;
+grid.Extract(mesh, 0.1);
+grid.Extract(mesh, Box(Vector(0.0), 2.5), 0.0, 2);
+\endcode
+
+The grid is also a field function, defined as the trilinear interpolation of the samples.
+
+Besides marching cubes, the surface can be extracted with dual methods that create one vertex per straddling cell
+and one quad per straddling edge, which yields as many triangles as marching cubes but almost no slivers.
+Dual contouring places the vertex so as to minimize the distance to the tangent planes at the edge crossings,
+which recovers sharp features; the gradient of the sampled field function gives the best tangent planes:
+
+\code
+grid.Extract(mesh, ScalarGrid::DualContouring, 0.0, &blend);
+\endcode
+*/
+
+/*!
+\brief Sample a field function on a cubic grid.
+\param f Field function.
+\param box Sampled region.
+\param n Number of grid nodes along each axis, at least 2.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+ScalarGrid::ScalarGrid(const AnalyticScalarField& f, const Box& box, int n, int threads) :ScalarGrid(f, box, n, n, n, threads)
+{
+}
+
+/*!
+\brief Sample a field function on a grid.
+\param f Field function.
+\param box Sampled region.
+\param x,y,z Number of grid nodes along each axis, at least 2.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+ScalarGrid::ScalarGrid(const AnalyticScalarField& f, const Box& box, int x, int y, int z, int threads) :box(box), nx(x), ny(y), nz(z), k(0.0)
+{
+  Vector diagonal = box.Diagonal();
+  d = Vector(diagonal[0] / (nx - 1), diagonal[1] / (ny - 1), diagonal[2] / (nz - 1));
+  field.resize(size_t(nx) * ny * nz);
+  Sample(f, 0, 0, 0, nx - 1, ny - 1, nz - 1, threads);
+}
+
+/*!
+\brief Sample the field function on a range of grid nodes, one row at a time with the batched evaluation of the field.
+
+This function is used to update the grid after an edit of the field restricted to a region.
+The Lipschitz bound of the trilinear interpolation is updated from the largest differences
+between adjacent samples along every axis in the range, it is never decreased.
+\param f Field function.
+\param i0,j0,k0,i1,j1,k1 Range of grid nodes, included.
+\param threads Number of threads, use all available cores if null or negative.
+*/
+void ScalarGrid::Sample(const AnalyticScalarField& f, int i0, int j0, int k0, int i1, int j1, int k1, int threads)
+{
+#ifdef _OPENMP
+  if (threads <= 0)
+  {
+    threads = omp_get_max_threads();
+  }
+#else
+  (void)threads;
+#endif
+
+  const int m = i1 - i0 + 1;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int c = k0; c <= k1; c++)
+  {
+    std::vector<double> x(m), y(m), z(m);
+    for (int j = j0; j <= j1; j++)
+    {
+      for (int i = 0; i < m; i++)
+      {
+        Vector p = Vertex(i0 + i, j, c);
+        x[i] = p[0];
+        y[i] = p[1];
+        z[i] = p[2];
+      }
+      f.Values(x.data(), y.data(), z.data(), &field[Index(i0, j, c)], m);
+    }
+  }
+
+  double gx = 0.0, gy = 0.0, gz = 0.0;
+  for (int c = std::max(k0 - 1, 0); c <= k1; c++)
+  {
+    for (int j = std::max(j0 - 1, 0); j <= j1; j++)
+    {
+      for (int i = std::max(i0 - 1, 0); i <= i1; i++)
+      {
+        const double v = Value(i, j, c);
+        if (i + 1 < nx) gx = Math::Max(gx, fabs(Value(i + 1, j, c) - v));
+        if (j + 1 < ny) gy = Math::Max(gy, fabs(Value(i, j + 1, c) - v));
+        if (c + 1 < nz) gz = Math::Max(gz, fabs(Value(i, j, c + 1) - v));
+      }
+    }
+  }
+  gx /= d[0];
+  gy /= d[1];
+  gz /= d[2];
+  k = Math::Max(k, sqrt(gx * gx + gy * gy + gz * gz));
+}
+
+/*!
+\brief Compute the trilinear interpolation of the samples.
+
+Points outside of the grid are projected onto its box.
+\param p Point.
+*/
+double ScalarGrid::Value(const Vector& p) const
+{
+  double u[3];
+  int c[3];
+  const int s[3] = { nx, ny, nz };
+  for (int a = 0; a < 3; a++)
+  {
+    const double t = Math::Clamp((p[a] - box[0][a]) / d[a], 0.0, double(s[a] - 1));
+    c[a] = std::min(int(t), s[a] - 2);
+    u[a] = t - c[a];
+  }
+
+  const int i = c[0], j = c[1], l = c[2];
+  const double x00 = (1.0 - u[0]) * Value(i, j, l) + u[0] * Value(i + 1, j, l);
+  const double x10 = (1.0 - u[0]) * Value(i, j + 1, l) + u[0] * Value(i + 1, j + 1, l);
+  const double x01 = (1.0 - u[0]) * Value(i, j, l + 1) + u[0] * Value(i + 1, j, l + 1);
+  const double x11 = (1.0 - u[0]) * Value(i, j + 1, l + 1) + u[0] * Value(i + 1, j + 1, l + 1);
+  const double y0 = (1.0 - u[1]) * x00 + u[1] * x10;
+  const double y1 = (1.0 - u[1]) * x01 + u[1] * x11;
+  return (1.0 - u[2]) * y0 + u[2] * y1;
+}
+
+/*!
+\brief Return the Lipschitz bound of the trilinear interpolation.
+*/
+double ScalarGrid::Lipschitz() const
+{
+  return k;
+}
+
+/*!
+\brief Compute the gradient at a grid node with central differences, one sided on the border of the grid.
+\param i,j,l Integer coordinates.
+*/
+Vector ScalarGrid::Gradient(int i, int j, int l) const
+{
+  const int ia = std::max(i - 1, 0), ib = std::min(i + 1, nx - 1);
+  const int ja = std::max(j - 1, 0), jb = std::min(j + 1, ny - 1);
+  const int la = std::max(l - 1, 0), lb = std::min(l + 1, nz - 1);
+  return Vector(
+    (Value(ib, j, l) - Value(ia, j, l)) / ((ib - ia) * d[0]),
+    (Value(i, jb, l) - Value(i, ja, l)) / ((jb - ja) * d[1]),
+    (Value(i, j, lb) - Value(i, j, la)) / ((lb - la) * d[2]));
+}
+
+/*!
+\brief Extract the iso-surface from the whole grid.
+\param g Returned geometry, with the storage it has on entry.
+\param iso Iso-value.
+\param s Stride, the extraction uses one grid node out of s along every axis.
+*/
+void ScalarGrid::Extract(Mesh& g, double iso, int s) const
+{
+  Extract(g, 0, 0, 0, nx - 1, ny - 1, nz - 1, iso, s);
+}
+
+/*!
+\brief Extract the iso-surface inside a sub-box of the grid.
+
+The extracted region is made of the cells overlapping the sub-box.
+\param g Returned geometry, with the storage it has on entry.
+\param region Sub-box.
+\param iso Iso-value.
+\param s Stride, the extraction uses one grid node out of s along every axis.
+*/
+void ScalarGrid::Extract(Mesh& g, const Box& region, double iso, int s) const
+{
+  int a[3], b[3];
+  const int n[3] = { nx, ny, nz };
+  for (int c = 0; c < 3; c++)
+  {
+    a[c] = std::min(std::max(int(floor((region[0][c] - box[0][c]) / d[c])), 0), n[c] - 1);
+    b[c] = std::min(std::max(int(ceil((region[1][c] - box[0][c]) / d[c])), 0), n[c] - 1);
+  }
+  Extract(g, a[0], a[1], a[2], b[0], b[1], b[2], iso, s);
+}
+
+/*!
+\brief Extract the iso-surface from a range of grid nodes with marching cubes.
+
+Vertices and triangles are created with the same ordering and table conventions as AnalyticScalarField::Polygonize().
+The range is extended by at most one stride when possible, so that it is covered by coarse cells.
+\param g Returned geometry, with the storage it has on entry.
+\param i0,j0,k0,i1,j1,k1 Range of grid nodes.
+\param iso Iso-value.
+\param s Stride.
+*/
+void ScalarGrid::Extract(Mesh& g, int i0, int j0, int k0, int i1, int j1, int k1, double iso, int s) const
+{
+  s = std::max(s, 1);
+  const int mx = std::min((i1 - i0 + s - 1) / s, (nx - 1 - i0) / s) + 1;
+  const int my = std::min((j1 - j0 + s - 1) / s, (ny - 1 - j0) / s) + 1;
+  const int mz = std::min((k1 - k0 + s - 1) / s, (nz - 1 - k0) / s) + 1;
+  if (mx < 2 || my < 2 || mz < 2)
+  {
+    g = Mesh(g.GetPrecision());
+    return;
+  }
+
+  VertexArray vertex(g.GetPrecision());
+  VertexArray normal(g.GetPrecision());
+  std::vector<int> triangle;
+
+  // Vertex on the edge between two nodes of the sub-grid, with the interpolated gradient as normal
+  auto edge = [&](int ia, int ja, int ka, int ib, int jb, int kb)
+    {
+      ia = i0 + ia * s; ja = j0 + ja * s; ka = k0 + ka * s;
+      ib = i0 + ib * s; jb = j0 + jb * s; kb = k0 + kb * s;
+      const double va = Value(ia, ja, ka) - iso;
+      const double vb = Value(ib, jb, kb) - iso;
+      const double t = va / (va - vb);
+      vertex.push_back(Vertex(ia, ja, ka) + t * (Vertex(ib, jb, kb) - Vertex(ia, ja, ka)));
+      normal.push_back(Normalized((1.0 - t) * Gradient(ia, ja, ka) + t * Gradient(ib, jb, kb)));
+      return int(vertex.size()) - 1;
+    };
+  // Values of the nodes of a plane of the sub-grid offset by the iso-value, in the layout of AnalyticScalarField::PolygonizeLayer()
+  auto sample = [&](int l, std::vector<double>& c)
+    {
+      for (int j = 0; j < my; j++)
+      {
+        const double* row = &field[Index(i0, j0 + j * s, k0 + l * s)];
+        for (int i = 0; i < mx; i++)
+        {
+          c[i * my + j] = row[i * s] - iso;
+        }
+      }
+    };
+
+  const int size = mx * my;
+  std::vector<double> a(size), b(size);
+  std::vector<int> eax(size), eay(size), ebx(size), eby(size), ez(size);
+
+  sample(0, a);
+
+  // Straddling edges inside lower Oxy plane
+  for (int i = 0; i < mx - 1; i++)
+  {
+    for (int j = 0; j < my; j++)
+    {
+      if ((a[i * my + j] < 0.0) != (a[(i + 1) * my + j] < 0.0)) eax[i * my + j] = edge(i, j, 0, i + 1, j, 0);
+    }
+  }
+  for (int i = 0; i < mx; i++)
+  {
+    for (int j = 0; j < my - 1; j++)
+    {
+      if ((a[i * my + j] < 0.0) != (a[i * my + (j + 1)] < 0.0)) eay[i * my + j] = edge(i, j, 0, i, j + 1, 0);
+    }
+  }
+
+  for (int l = 0; l < mz - 1; l++)
+  {
+    sample(l + 1, b);
+
+    // Straddling edges inside upper Oxy plane
+    for (int i = 0; i < mx - 1; i++)
+    {
+      for (int j = 0; j < my; j++)
+      {
+        if ((b[i * my + j] < 0.0) != (b[(i + 1) * my + j] < 0.0)) ebx[i * my + j] = edge(i, j, l + 1, i + 1, j, l + 1);
+      }
+    }
+    for (int i = 0; i < mx; i++)
+    {
+      for (int j = 0; j < my - 1; j++)
+      {
+        if ((b[i * my + j] < 0.0) != (b[i * my + (j + 1)] < 0.0)) eby[i * my + j] = edge(i, j, l + 1, i, j + 1, l + 1);
+      }
+    }
+
+    // Vertical straddling edges
+    for (int i = 0; i < mx; i++)
+    {
+      for (int j = 0; j < my; j++)
+      {
+        if ((a[i * my + j] < 0.0) != (b[i * my + j] < 0.0)) ez[i * my + j] = edge(i, j, l, i, j, l + 1);
+      }
+    }
+
+    PolygonizeLayer(mx, my, a.data(), b.data(), eax.data(), eay.data(), ebx.data(), eby.data(), ez.data(), triangle);
+
+    std::swap(a, b);
+    std::swap(eax, ebx);
+    std::swap(eay, eby);
+  }
+
+  std::vector<int> normals = triangle;
+
+  g = Mesh(vertex, normal, triangle, normals);
+}
+
+/*!
+\brief Extract the iso-surface from the whole grid with a given method.
+
+Dual methods use the same samples as marching cubes. The normals at the edge crossings are the gradient of the field function
+if provided, otherwise the interpolated central differences of the grid.
+\param g Returned geometry, with the storage it has on entry.
+\param method Extraction method.
+\param iso Iso-value.
+\param f Field function used for the gradient at edge crossings, may be null.
+*/
+void ScalarGrid::Extract(Mesh& g, Extraction method, double iso, const AnalyticScalarField* f) const
+{
+  if (method == MarchingCubes)
+  {
+    Extract(g, iso, 1);
+  }
+  else
+  {
+    ExtractDual(g, method, iso, f);
+  }
+}
+
+/*!
+\brief Extract the iso-surface with surface nets or dual contouring.
+
+Every straddling cell gets a vertex, and every straddling edge shared by four cells creates a quad
+joining their vertices, split along its shortest diagonal. Cells crossed by several sheets of the surface get
+a single vertex, therefore the mesh may have non-manifold edges where marching cubes would separate the sheets.
+\param g Returned geometry, with the storage it has on entry.
+\param method Extraction method, either ScalarGrid::SurfaceNets or ScalarGrid::DualContouring.
+\param iso Iso-value.
+\param f Field function used for the gradient at edge crossings, may be null.
+*/
+void ScalarGrid::ExtractDual(Mesh& g, Extraction method, double iso, const AnalyticScalarField* f) const
+{
+  const int mx = nx - 1;
+  const int my = ny - 1;
+  const int mz = nz - 1;
+
+  VertexArray vertex(g.GetPrecision());
+  VertexArray normal(g.GetPrecision());
+  std::vector<int> triangle;
+
+  // Classification of the nodes
+  std::vector<char> in(field.size());
+  for (size_t i = 0; i < field.size(); i++)
+  {
+    in[i] = field[i] < iso;
+  }
+
+  // Vertex index of every cell
+  std::vector<int> cell(size_t(mx) * my * mz, -1);
+
+  for (int k = 0; k < mz; k++)
+  {
+    for (int j = 0; j < my; j++)
+    {
+      for (int i = 0; i < mx; i++)
+      {
+        const size_t n0 = Index(i, j, k);
+        const size_t plane = size_t(nx) * ny;
+        const int inside = in[n0] + in[n0 + 1] + in[n0 + nx] + in[n0 + nx + 1]
+          + in[n0 + plane] + in[n0 + plane + 1] + in[n0 + plane + nx] + in[n0 + plane + nx + 1];
+
+        // Cell is not straddling the surface
+        if (inside == 0 || inside == 8)
+        {
+          continue;
+        }
+
+        double v[8];
+        for (int c = 0; c < 8; c++)
+        {
+          v[c] = Value(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1)) - iso;
+        }
+
+        Vector gc[8];
+        if (f == nullptr)
+        {
+          for (int c = 0; c < 8; c++)
+          {
+            gc[c] = Gradient(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1));
+          }
+        }
+
+        // Edge crossings with their normals, and the quadratic error accumulated as the upper part of AtA and Atb
+        const Vector o = Vertex(i, j, k);
+        Vector mass = Vector::Null;
+        Vector n = Vector::Null;
+        double qef[9] = { 0.0 };
+        int ne = 0;
+        for (int h = 0; h < 12; h++)
+        {
+          const int ca = CubeEdge[h][0];
+          const int cb = CubeEdge[h][1];
+          if ((v[ca] < 0.0) == (v[cb] < 0.0))
+          {
+            continue;
+          }
+          const double t = v[ca] / (v[ca] - v[cb]);
+          const Vector pa = o + Vector((ca & 1) * d[0], ((ca >> 1) & 1) * d[1], ((ca >> 2) & 1) * d[2]);
+          const Vector pb = o + Vector((cb & 1) * d[0], ((cb >> 1) & 1) * d[1], ((cb >> 2) & 1) * d[2]);
+          const Vector p = pa + t * (pb - pa);
+          const Vector np = Normalized(f ? f->Gradient(p) : (1.0 - t) * gc[ca] + t * gc[cb]);
+
+          mass += p;
+          n += np;
+          ne++;
+
+          const double b = np * p;
+          qef[0] += np[0] * np[0]; qef[1] += np[0] * np[1]; qef[2] += np[0] * np[2];
+          qef[3] += np[1] * np[1]; qef[4] += np[1] * np[2]; qef[5] += np[2] * np[2];
+          qef[6] += np[0] * b; qef[7] += np[1] * b; qef[8] += np[2] * b;
+        }
+        mass /= ne;
+
+        Vector p = mass;
+        if (method == DualContouring)
+        {
+          p = SolveQef(qef, mass);
+
+          // Keep the vertex inside its cell
+          for (int a = 0; a < 3; a++)
+          {
+            p[a] = Math::Clamp(p[a], o[a], o[a] + d[a]);
+          }
+        }
+
+        cell[(size_t(k) * my + j) * mx + i] = int(vertex.size());
+        vertex.push_back(p);
+        normal.push_back(Normalized(n));
+      }
+    }
+  }
+
+  // Quad around a straddling edge, given the cells in counter-clockwise order around the axis of the edge,
+  // reversed if the first node of the edge is inside so that triangles have the orientation of marching cubes
+  auto quad = [&](size_t c0, size_t c1, size_t c2, size_t c3, bool inside)
+    {
+      int q[4] = { cell[c0], cell[c1], cell[c2], cell[c3] };
+      if (inside)
+      {
+        std::swap(q[1], q[3]);
+      }
+      if (SquaredNorm(vertex[q[0]] - vertex[q[2]]) <= SquaredNorm(vertex[q[1]] - vertex[q[3]]))
+      {
+        triangle.insert(triangle.end(), { q[0], q[1], q[2], q[0], q[2], q[3] });
+      }
+      else
+      {
+        triangle.insert(triangle.end(), { q[0], q[1], q[3], q[1], q[2], q[3] });
+      }
+    };
+  auto index = [&](int i, int j, int k) { return (size_t(k) * my + j) * mx + i; };
+
+  for (int k = 0; k < nz; k++)
+  {
+    for (int j = 0; j < ny; j++)
+    {
+      for (int i = 0; i < nx; i++)
+      {
+        const size_t n0 = Index(i, j, k);
+        const char a = in[n0];
+
+        // Edge along x, shared by cells in the Oyz plane
+        if (i < mx && j > 0 && j < my && k > 0 && k < mz && a != in[n0 + 1])
+        {
+          quad(index(i, j - 1, k - 1), index(i, j, k - 1), index(i, j, k), index(i, j - 1, k), a);
+        }
+        // Edge along y, shared by cells in the Ozx plane
+        if (j < my && i > 0 && i < mx && k > 0 && k < mz && a != in[n0 + nx])
+        {
+          quad(index(i - 1, j, k - 1), index(i - 1, j, k), index(i, j, k), index(i, j, k - 1), a);
+        }
+        // Edge along z, shared by cells in the Oxy plane
+        if (k < mz && i > 0 && i < mx && j > 0 && j < my && a != in[n0 + size_t(nx) * ny])
+        {
+          quad(index(i - 1, j - 1, k), index(i, j - 1, k), index(i, j, k), index(i - 1, j, k), a);
+        }
+      }
+    }
+  }
+
+  std::vector<int> normals = triangle;
+
+  g = Mesh(vertex, normal, triangle, normals);
+}
+
+/*!
+\brief Minimize the quadratic error to a set of planes.
+
+The error is expressed relative to the mass point, and the symmetric matrix AtA is diagonalized with Jacobi rotations.
+Small eigenvalues are truncated, so that the solution falls back to the mass point along directions where the planes are parallel,
+for instance on flat regions or along sharp edges.
+\param q Quadratic error, upper part of AtA in the first six entries followed by Atb.
+\param c Mass point.
+*/
+Vector ScalarGrid::SolveQef(const double* q, const Vector& c)
+{
+  double a[3][3] = { { q[0], q[1], q[2] }, { q[1], q[3], q[4] }, { q[2], q[4], q[5] } };
+  double v[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+
+  // Right hand side relative to the mass point
+  double b[3];
+  for (int i = 0; i < 3; i++)
+  {
+    b[i] = q[6 + i] - (a[i][0] * c[0] + a[i][1] * c[1] + a[i][2] * c[2]);
+  }
+
+  // Cyclic Jacobi sweeps
+  for (int sweep = 0; sweep < 8; sweep++)
+  {
+    const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    if (off < 1e-20)
+    {
+      break;
+    }
+    for (int p = 0; p < 2; p++)
+    {
+      for (int r = p + 1; r < 3; r++)
+      {
+        if (fabs(a[p][r]) < 1e-20)
+        {
+          continue;
+        }
+        const double theta = (a[r][r] - a[p][p]) / (2.0 * a[p][r]);
+        const double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        const double cs = 1.0 / sqrt(t * t + 1.0);
+        const double sn = t * cs;
+        for (int k = 0; k < 3; k++)
+        {
+          const double akp = a[k][p], akr = a[k][r];
+          a[k][p] = cs * akp - sn * akr;
+          a[k][r] = sn * akp + cs * akr;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+          const double apk = a[p][k], ark = a[r][k];
+          a[p][k] = cs * apk - sn * ark;
+          a[r][k] = sn * apk + cs * ark;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+          const double vkp = v[k][p], vkr = v[k][r];
+          v[k][p] = cs * vkp - sn * vkr;
+          v[k][r] = sn * vkp + cs * vkr;
+        }
+      }
+    }
+  }
+
+  // Truncated pseudo-inverse
+  const double emax = Math::Max(fabs(a[0][0]), fabs(a[1][1]), fabs(a[2][2]));
+  Vector x = c;
+  for (int e = 0; e < 3; e++)
+  {
+    if (fabs(a[e][e]) < 0.1 * emax)
+    {
+      continue;
+    }
+    const double s = (v[0][e] * b[0] + v[1][e] * b[1] + v[2][e] * b[2]) / a[e][e];
+    x += s * Vector(v[0][e], v[1][e], v[2][e]);
+  }
+  return x;
+}
@@ -0,0 +1,319 @@
+// Array of vertices with selectable precision
+
+// Self include
+#include "vertex-array.h"
+
+#include "../matrix.h"
+
+#include <algorithm>
+
+/*!
+\class VertexArray vertex-array.h
+\brief An array of vertices, stored either as vectors in double precision or as three arrays of coordinates in single precision.
+
+The single precision storage takes 12 bytes per vertex instead of 24, and its structure of arrays layout lets the compiler
+vectorize the loops of the transformations. Vertices are returned as Vector whatever the storage, and are rounded when set:
+
+\code
+VertexArray a(VertexArray::Float);
+a.push_back(Vector(1.0, 2.0, 3.0));
+a.Set(0, a[0] + Vector(0.5));
+a.Scale(2.0);
+\endcode
+
+The interface follows that of std::vector for the operations that do not depend on the storage, so that the array
+can be used in place of the std::vector<Vector> of a Mesh.
+*/
+
+/*!
+\brief Create an empty array.
+\param p Storage.
+*/
+VertexArray::VertexArray(Precision p) :precision(p)
+{
+}
+
+/*!
+\brief Create an array from a set of vertices.
+\param a Vertices.
+\param p Storage.
+*/
+VertexArray::VertexArray(const std::vector<Vector>& a, Precision p) :precision(p)
+{
+  Append(a);
+}
+
+/*!
+\brief Reserve memory.
+\param n Number of vertices.
+*/
+void VertexArray::reserve(int n)
+{
+  if (precision == Double)
+  {
+    v.reserve(n);
+  }
+  else
+  {
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+  }
+}
+
+/*!
+\brief Resize the array.
+\param n Number of vertices.
+\param p Added vertices.
+*/
+void VertexArray::resize(int n, const Vector& p)
+{
+  if (precision == Double)
+  {
+    v.resize(n, p);
+  }
+  else
+  {
+    x.resize(n, float(p[0]));
+    y.resize(n, float(p[1]));
+    z.resize(n, float(p[2]));
+  }
+}
+
+/*!
+\brief Empty the array, the storage is kept.
+*/
+void VertexArray::clear()
+{
+  v.clear();
+  x.clear();
+  y.clear();
+  z.clear();
+}
+
+/*!
+\brief Add the vertices of another array at the end of the array.
+\param a Array, whose storage may be different.
+*/
+void VertexArray::Append(const VertexArray& a)
+{
+  if (a.precision == Double)
+  {
+    Append(a.v);
+  }
+  else if (precision == Float)
+  {
+    x.insert(x.end(), a.x.begin(), a.x.end());
+    y.insert(y.end(), a.y.begin(), a.y.end());
+    z.insert(z.end(), a.z.begin(), a.z.end());
+  }
+  else
+  {
+    const int n = a.size();
+    v.reserve(v.size() + n);
+    for (int i = 0; i < n; i++)
+    {
+      v.push_back(a[i]);
+    }
+  }
+}
+
+/*!
+\brief Add a set of vertices at the end of the array.
+\param a Vertices.
+*/
+void VertexArray::Append(const std::vector<Vector>& a)
+{
+  if (precision == Double)
+  {
+    v.insert(v.end(), a.begin(), a.end());
+  }
+  else
+  {
+    const int n = size() + int(a.size());
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+    for (const Vector& p : a)
+    {
+      push_back(p);
+    }
+  }
+}
+
+/*!
+\brief Change the storage, the vertices are rounded when going to single precision.
+\param p Storage.
+*/
+void VertexArray::SetPrecision(Precision p)
+{
+  if (p == precision)
+  {
+    return;
+  }
+  VertexArray a(p);
+  a.Append(*this);
+  *this = a;
+}
+
+/*!
+\brief Return the array of a coordinate of the vertices in single precision storage, nullptr in double precision.
+\param i Axis.
+*/
+const float* VertexArray::Coordinates(int i) const
+{
+  if (precision == Double)
+  {
+    return nullptr;
+  }
+  const std::vector<float>& c = (i == 0) ? x : ((i == 1) ? y : z);
+  return c.data();
+}
+
+/*!
+\brief Return the memory used by the vertices, in bytes.
+*/
+long long VertexArray::Memory() const
+{
+  return (precision == Double) ? (long long)(v.capacity()) * sizeof(Vector) : (long long)(x.capacity() + y.capacity() + z.capacity()) * sizeof(float);
+}
+
+/*!
+\brief Compute the bounding box of the vertices.
+
+The array should not be empty.
+*/
+Box VertexArray::GetBox() const
+{
+  if (precision == Double)
+  {
+    return Box(v);
+  }
+  float a[3] = { x[0], y[0], z[0] };
+  float b[3] = { x[0], y[0], z[0] };
+  const int n = size();
+  for (int i = 1; i < n; i++)
+  {
+    a[0] = std::min(a[0], x[i]);
+    a[1] = std::min(a[1], y[i]);
+    a[2] = std::min(a[2], z[i]);
+    b[0] = std::max(b[0], x[i]);
+    b[1] = std::max(b[1], y[i]);
+    b[2] = std::max(b[2], z[i]);
+  }
+  return Box(Vector(a[0], a[1], a[2]), Vector(b[0], b[1], b[2]));
+}
+
+/*!
+\brief Scale the vertices.
+\param s Scaling factor.
+*/
+void VertexArray::Scale(double s)
+{
+  Scale(Vector(s));
+}
+
+/*!
+\brief Scale the vertices.
+\param s Scaling factors along the axes.
+*/
+void VertexArray::Scale(const Vector& s)
+{
+  if (precision == Double)
+  {
+    for (Vector& p : v)
+    {
+      p *= s;
+    }
+    return;
+  }
+  const int n = size();
+  const float sx = float(s[0]), sy = float(s[1]), sz = float(s[2]);
+  for (int i = 0; i < n; i++)
+  {
+    x[i] *= sx;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    y[i] *= sy;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    z[i] *= sz;
+  }
+}
+
+/*!
+\brief Translate the vertices.
+\param t Translation vector.
+*/
+void VertexArray::Translate(const Vector& t)
+{
+  if (precision == Double)
+  {
+    for (Vector& p : v)
+    {
+      p += t;
+    }
+    return;
+  }
+  const int n = size();
+  const float tx = float(t[0]), ty = float(t[1]), tz = float(t[2]);
+  for (int i = 0; i < n; i++)
+  {
+    x[i] += tx;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    y[i] += ty;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    z[i] += tz;
+  }
+}
+
+/*!
+\brief Transform the vertices by a 3x3 matrix.
+\param m Matrix.
+*/
+void VertexArray::Transform(const Matrix& m)
+{
+  if (precision == Double)
+  {
+    for (Vector& p : v)
+    {
+      p = Vector(m.tab[0][0] * p[0] + m.tab[0][1] * p[1] + m.tab[0][2] * p[2],
+        m.tab[1][0] * p[0] + m.tab[1][1] * p[1] + m.tab[1][2] * p[2],
+        m.tab[2][0] * p[0] + m.tab[2][1] * p[1] + m.tab[2][2] * p[2]);
+    }
+    return;
+  }
+  float c[3][3];
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      c[i][j] = float(m.tab[i][j]);
+    }
+  }
+  const int n = size();
+  float* px = x.data();
+  float* py = y.data();
+  float* pz = z.data();
+  for (int i = 0; i < n; i++)
+  {
+    const float a = px[i], b = py[i], d = pz[i];
+    px[i] = c[0][0] * a + c[0][1] * b + c[0][2] * d;
+    py[i] = c[1][0] * a + c[1][1] * b + c[1][2] * d;
+    pz[i] = c[2][0] * a + c[2][1] * b + c[2][2] * d;
+  }
+}
+
+/*!
+\brief Negate the vertices, which is used for flipping normals.
+*/
+void VertexArray::Negate()
+{
+  Scale(-1.0);
+}
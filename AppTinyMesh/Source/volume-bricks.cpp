@@ -0,0 +1,721 @@
+// Bricked multi-resolution volume
+
+// Self include
+#include "volume-bricks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+/*!
+\class BrickedVolumeField volume-bricks.h
+\brief A field function defined by a large sampled volume stored as a hierarchy of bricks on disk.
+
+The volume is split into bricks of a fixed number of cells along every axis. Every level of the hierarchy halves the resolution
+of the previous one with a tent filter, and is bricked the same way. Bricks store one more sample than cells along every axis,
+so that the trilinear interpolation inside a cell never needs two bricks.
+
+The minimum and maximum sample of every brick are kept in memory, while the samples are paged in from the file only when
+they are needed and kept in a least recently used cache of bounded size. Evaluations are exact and read the bricks they need.
+BrickedVolumeField::Polygonize() evaluates exactly only the grid nodes of the cells overlapping a brick that straddles the iso-value,
+and the other nodes get a bound with the correct sign from the range of their brick, which is not read.
+Therefore the polygonization only reads the bricks that contain the surface:
+
+\code
+VolumeScalarField raw("scan.raw", 2048, 2048, 2048, VolumeScalarField::UInt16, Box(Vector(0.0), Vector(20.48)));
+BrickedVolumeField::Create(raw, "scan.bricks");
+
+BrickedVolumeField volume("scan.bricks", 1200.0);
+volume.SetLevel(volume.Select(0.08)); // Preview with samples every 0.8 mm
+Mesh mesh(VertexArray::Float);
+volume.Polygonize(mesh);
+\endcode
+
+Samples are stored as 32-bit floating point values whatever the type of the source volume.
+The file is a header, the minimum and maximum of the bricks of all levels, and the bricks, x varying the fastest.
+*/
+
+/*!
+\brief Open a brick file created by BrickedVolumeField::Create().
+
+If the file cannot be read, the volume is not open, see BrickedVolumeField::IsOpen(), and is empty: its field is infinite.
+\param filename File name.
+\param value Iso-value.
+\param cache Size of the cache in bytes, at least one brick is kept in memory.
+*/
+BrickedVolumeField::BrickedVolumeField(const std::string& filename, double value, size_t cache)
+  :brick(1), level(0), iso(value), data(0), capacity(1), loads(0)
+{
+  file.open(filename, std::ios::binary);
+  if (!file)
+  {
+    return;
+  }
+
+  char magic[4];
+  int header[6];
+  double corners[6];
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  file.read(reinterpret_cast<char*>(corners), sizeof(corners));
+  if (!file || std::strncmp(magic, "TMBV", 4) != 0 || header[0] != 1 || header[4] < 1 || header[5] < 1)
+  {
+    file.close();
+    return;
+  }
+
+  box = Box(Vector(corners[0], corners[1], corners[2]), Vector(corners[3], corners[4], corners[5]));
+  brick = header[4];
+  Layout(box, header[1], header[2], header[3], brick, header[5], levels);
+  for (int l = 0; l < int(levels.size()); l++)
+  {
+    file.read(reinterpret_cast<char*>(levels[l].range.data()), levels[l].range.size() * sizeof(float));
+  }
+  data = file.tellg();
+
+  if (!file || int(levels.size()) != header[5])
+  {
+    levels.clear();
+    file.close();
+    return;
+  }
+
+  const size_t s = brick + 1;
+  capacity = std::max(cache / (s * s * s * sizeof(float)), size_t(1));
+}
+
+/*!
+\brief Create a brick file from a raw volume.
+
+The volume is read once, brick by brick, and coarser levels are computed from the bricks of the previous level read back
+from the file, so that the memory needed does not depend on the size of the volume.
+\param source Raw volume.
+\param filename File name.
+\param b Number of cells of a brick along every axis.
+\param count Number of levels, if null or negative levels are added until a level fits in a single brick.
+*/
+bool BrickedVolumeField::Create(const VolumeScalarField& source, const std::string& filename, int b, int count)
+{
+  if (!source.IsOpen() || b < 1)
+  {
+    return false;
+  }
+
+  const Box box = source.GetBox();
+  std::vector<Level> levels;
+  Layout(box, source.Size(0), source.Size(1), source.Size(2), b, count, levels);
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out)
+  {
+    return false;
+  }
+
+  const int header[6] = { 1, source.Size(0), source.Size(1), source.Size(2), b, int(levels.size()) };
+  const double corners[6] = { box[0][0], box[0][1], box[0][2], box[1][0], box[1][1], box[1][2] };
+  out.write("TMBV", 4);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(corners), sizeof(corners));
+
+  // Ranges are written once all the bricks are known
+  const long long table = out.tellp();
+  for (int l = 0; l < int(levels.size()); l++)
+  {
+    out.write(reinterpret_cast<const char*>(levels[l].range.data()), levels[l].range.size() * sizeof(float));
+  }
+
+  const int s = b + 1;
+  std::vector<float> samples(size_t(s) * s * s);
+
+  // Finest level, copied from the volume
+  Level& finest = levels[0];
+  for (int c = 0; c < finest.bz; c++)
+  {
+    for (int bj = 0; bj < finest.by; bj++)
+    {
+      for (int bi = 0; bi < finest.bx; bi++)
+      {
+        float lo = std::numeric_limits<float>::infinity();
+        float hi = -lo;
+        for (int z = 0; z < s; z++)
+        {
+          const int k = std::min(c * b + z, finest.nz - 1);
+          for (int y = 0; y < s; y++)
+          {
+            const int j = std::min(bj * b + y, finest.ny - 1);
+            for (int x = 0; x < s; x++)
+            {
+              const int i = std::min(bi * b + x, finest.nx - 1);
+              const float v = float(source.Voxel(i, j, k));
+              samples[(size_t(z) * s + y) * s + x] = v;
+              lo = std::min(lo, v);
+              hi = std::max(hi, v);
+            }
+          }
+        }
+        const int index = (c * finest.by + bj) * finest.bx + bi;
+        finest.range[2 * index] = lo;
+        finest.range[2 * index + 1] = hi;
+        out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+      }
+    }
+  }
+
+  // Coarser levels, filtered from the previous level read back from the file
+  const int w = 2 * b + 3;
+  std::vector<float> input, tx(size_t(w) * w * s), ty(size_t(w) * s * s);
+  std::vector<int> centers(3 * s);
+  for (int l = 1; l < int(levels.size()); l++)
+  {
+    out.flush();
+    BrickedVolumeField reader(filename);
+    if (!reader.IsOpen())
+    {
+      return false;
+    }
+
+    Level& coarse = levels[l];
+    const int n[3] = { coarse.nx, coarse.ny, coarse.nz };
+    for (int c = 0; c < coarse.bz; c++)
+    {
+      for (int bj = 0; bj < coarse.by; bj++)
+      {
+        for (int bi = 0; bi < coarse.bx; bi++)
+        {
+          const int base[3] = { bi * b, bj * b, c * b };
+          const int lo[3] = { 2 * base[0] - 1, 2 * base[1] - 1, 2 * base[2] - 1 };
+          const int size[3] = { w, w, w };
+          reader.Region(l - 1, lo, size, input);
+
+          // Centers of the filter in the region, samples beyond the level are replicated
+          for (int a = 0; a < 3; a++)
+          {
+            for (int x = 0; x < s; x++)
+            {
+              centers[a * s + x] = 2 * std::min(base[a] + x, n[a] - 1) - lo[a];
+            }
+          }
+
+          // Separable tent filter
+          for (int z = 0; z < w; z++)
+          {
+            for (int y = 0; y < w; y++)
+            {
+              const float* p = &input[(size_t(z) * w + y) * w];
+              for (int x = 0; x < s; x++)
+              {
+                const int m = centers[x];
+                tx[(size_t(z) * w + y) * s + x] = 0.25f * p[m - 1] + 0.5f * p[m] + 0.25f * p[m + 1];
+              }
+            }
+          }
+          for (int z = 0; z < w; z++)
+          {
+            for (int y = 0; y < s; y++)
+            {
+              const int m = centers[s + y];
+              for (int x = 0; x < s; x++)
+              {
+                const size_t q = (size_t(z) * w + m) * s + x;
+                ty[(size_t(z) * s + y) * s + x] = 0.25f * tx[q - s] + 0.5f * tx[q] + 0.25f * tx[q + s];
+              }
+            }
+          }
+          float vlo = std::numeric_limits<float>::infinity();
+          float vhi = -vlo;
+          for (int z = 0; z < s; z++)
+          {
+            const int m = centers[2 * s + z];
+            for (int y = 0; y < s; y++)
+            {
+              for (int x = 0; x < s; x++)
+              {
+                const size_t q = (size_t(m) * s + y) * s + x;
+                const float v = 0.25f * ty[q - s * s] + 0.5f * ty[q] + 0.25f * ty[q + s * s];
+                samples[(size_t(z) * s + y) * s + x] = v;
+                vlo = std::min(vlo, v);
+                vhi = std::max(vhi, v);
+              }
+            }
+          }
+          const int index = (c * coarse.by + bj) * coarse.bx + bi;
+          coarse.range[2 * index] = vlo;
+          coarse.range[2 * index + 1] = vhi;
+          out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+        }
+      }
+    }
+  }
+
+  out.seekp(table);
+  for (int l = 0; l < int(levels.size()); l++)
+  {
+    out.write(reinterpret_cast<const char*>(levels[l].range.data()), levels[l].range.size() * sizeof(float));
+  }
+  return bool(out);
+}
+
+/*!
+\brief Compute the size of the levels and of their bricks.
+\param box Region covered by the volume.
+\param nx,ny,nz Number of samples of the finest level.
+\param b Number of cells of a brick along every axis.
+\param count Number of levels, if null or negative levels are added until a level fits in a single brick.
+\param levels Returned levels, with their ranges set to zero.
+*/
+void BrickedVolumeField::Layout(const Box& box, int nx, int ny, int nz, int b, int count, std::vector<Level>& levels)
+{
+  levels.clear();
+
+  const Vector diagonal = box.Diagonal();
+  Level l;
+  l.nx = nx;
+  l.ny = ny;
+  l.nz = nz;
+  l.d = Vector(diagonal[0] / (nx - 1), diagonal[1] / (ny - 1), diagonal[2] / (nz - 1));
+  l.first = 0;
+  while (true)
+  {
+    l.bx = (l.nx - 2) / b + 1;
+    l.by = (l.ny - 2) / b + 1;
+    l.bz = (l.nz - 2) / b + 1;
+    const long long bricks = (long long)(l.bx) * l.by * l.bz;
+    l.range.assign(2 * bricks, 0.0f);
+    levels.push_back(l);
+    l.first += bricks;
+
+    if (count > 0 && int(levels.size()) == count)
+    {
+      break;
+    }
+    if (count <= 0 && std::max(std::max(l.nx, l.ny), l.nz) - 1 <= b)
+    {
+      break;
+    }
+    // Halving needs at least two cells along every axis
+    if (std::min(std::min(l.nx, l.ny), l.nz) < 3)
+    {
+      break;
+    }
+    l.nx = (l.nx - 1) / 2 + 1;
+    l.ny = (l.ny - 1) / 2 + 1;
+    l.nz = (l.nz - 1) / 2 + 1;
+    l.d = 2.0 * l.d;
+  }
+}
+
+/*!
+\brief Check whether the brick file has been opened.
+*/
+bool BrickedVolumeField::IsOpen() const
+{
+  return !levels.empty();
+}
+
+/*!
+\brief Return a brick, read from the file if it is not in the cache.
+
+The least recently used bricks are evicted when the cache is full. Bricks remain valid as long as they are referenced,
+even after they have been evicted.
+\param l Level.
+\param index Index of the brick in the level.
+*/
+BrickedVolumeField::Brick BrickedVolumeField::Fetch(int l, int index) const
+{
+  const long long key = levels[l].first + index;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = pages.find(key);
+  if (it != pages.end())
+  {
+    recent.splice(recent.begin(), recent, it->second.recent);
+    return it->second.brick;
+  }
+
+  const size_t s = brick + 1;
+  std::shared_ptr<std::vector<float> > samples = std::make_shared<std::vector<float> >(s * s * s);
+  file.seekg(data + key * (long long)(samples->size() * sizeof(float)));
+  file.read(reinterpret_cast<char*>(samples->data()), samples->size() * sizeof(float));
+  if (!file)
+  {
+    file.clear();
+  }
+  loads++;
+
+  recent.push_front(key);
+  Page page;
+  page.brick = samples;
+  page.recent = recent.begin();
+  pages[key] = page;
+  while (pages.size() > capacity)
+  {
+    pages.erase(recent.back());
+    recent.pop_back();
+  }
+  return samples;
+}
+
+/*!
+\brief Find the brick containing a point and the coordinates of the point in the brick.
+
+Points outside of the volume are projected onto its box.
+\param l Level.
+\param p Point.
+\param u Returned coordinates in the brick, in cells.
+\return Index of the brick in the level.
+*/
+int BrickedVolumeField::Locate(const Level& l, const Vector& p, Vector& u) const
+{
+  const int n[3] = { l.nx, l.ny, l.nz };
+  const int m[3] = { l.bx, l.by, l.bz };
+  int b[3];
+  for (int a = 0; a < 3; a++)
+  {
+    const double t = Math::Clamp((p[a] - box[0][a]) / l.d[a], 0.0, double(n[a] - 1));
+    const int c = std::min(int(t), n[a] - 2);
+    b[a] = std::min(c / brick, m[a] - 1);
+    u[a] = t - b[a] * brick;
+  }
+  return (b[2] * l.by + b[1]) * l.bx + b[0];
+}
+
+/*!
+\brief Compute the trilinear interpolation of the samples of a brick.
+\param samples Samples of the brick.
+\param u Coordinates in the brick, in cells.
+*/
+double BrickedVolumeField::Interpolate(const std::vector<float>& samples, const Vector& u) const
+{
+  const int s = brick + 1;
+  int c[3];
+  double w[3];
+  for (int a = 0; a < 3; a++)
+  {
+    c[a] = std::min(std::max(int(u[a]), 0), brick - 1);
+    w[a] = u[a] - c[a];
+  }
+
+  const float* p = &samples[(size_t(c[2]) * s + c[1]) * s + c[0]];
+  const size_t sy = s;
+  const size_t sz = size_t(s) * s;
+  const double x00 = (1.0 - w[0]) * p[0] + w[0] * p[1];
+  const double x10 = (1.0 - w[0]) * p[sy] + w[0] * p[sy + 1];
+  const double x01 = (1.0 - w[0]) * p[sz] + w[0] * p[sz + 1];
+  const double x11 = (1.0 - w[0]) * p[sz + sy] + w[0] * p[sz + sy + 1];
+  const double y0 = (1.0 - w[1]) * x00 + w[1] * x10;
+  const double y1 = (1.0 - w[1]) * x01 + w[1] * x11;
+  return (1.0 - w[2]) * y0 + w[2] * y1;
+}
+
+/*!
+\brief Copy a region of samples of a level, reading every brick once.
+
+Samples outside of the level are replicated from its border.
+\param l Level.
+\param lo Integer coordinates of the first sample.
+\param size Number of samples along each axis.
+\param out Returned samples, x varies the fastest.
+*/
+void BrickedVolumeField::Region(int l, const int* lo, const int* size, std::vector<float>& out) const
+{
+  const Level& v = levels[l];
+  const int n[3] = { v.nx, v.ny, v.nz };
+  const int m[3] = { v.bx, v.by, v.bz };
+
+  // Brick and local coordinate of every row, column and slice
+  std::vector<int> b[3], u[3];
+  for (int a = 0; a < 3; a++)
+  {
+    b[a].resize(size[a]);
+    u[a].resize(size[a]);
+    for (int x = 0; x < size[a]; x++)
+    {
+      const int g = std::min(std::max(lo[a] + x, 0), n[a] - 1);
+      b[a][x] = std::min(g / brick, m[a] - 1);
+      u[a][x] = g - b[a][x] * brick;
+    }
+  }
+
+  const size_t s = brick + 1;
+  out.resize(size_t(size[0]) * size[1] * size[2]);
+  std::unordered_map<int, Brick> bricks;
+  for (int z = 0; z < size[2]; z++)
+  {
+    for (int y = 0; y < size[1]; y++)
+    {
+      int current = -1;
+      const float* p = nullptr;
+      for (int x = 0; x < size[0]; x++)
+      {
+        const int index = (b[2][z] * v.by + b[1][y]) * v.bx + b[0][x];
+        if (index != current)
+        {
+          auto it = bricks.find(index);
+          if (it == bricks.end())
+          {
+            it = bricks.emplace(index, Fetch(l, index)).first;
+          }
+          p = it->second->data();
+          current = index;
+        }
+        out[(size_t(z) * size[1] + y) * size[0] + x] = p[(u[2][z] * s + u[1][y]) * s + u[0][x]];
+      }
+    }
+  }
+}
+
+/*!
+\brief Compute the value of the field, negative where the volume is greater than the iso-value.
+
+The brick containing the point is read if needed.
+\param p Point.
+*/
+double BrickedVolumeField::Value(const Vector& p) const
+{
+  if (!IsOpen())
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  Vector u;
+  const int index = Locate(levels[level], p, u);
+  return iso - Interpolate(*Fetch(level, index), u);
+}
+
+/*!
+\brief Compute the value of the field at a set of points.
+
+Consecutive points in the same brick share a single lookup in the cache.
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void BrickedVolumeField::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  if (!IsOpen())
+  {
+    std::fill(v, v + n, std::numeric_limits<double>::infinity());
+    return;
+  }
+  const Level& l = levels[level];
+  int current = -1;
+  Brick samples;
+  for (int h = 0; h < n; h++)
+  {
+    Vector u;
+    const int index = Locate(l, Vector(x[h], y[h], z[h]), u);
+    if (index != current)
+    {
+      samples = Fetch(level, index);
+      current = index;
+    }
+    v[h] = iso - Interpolate(*samples, u);
+  }
+}
+
+/*!
+\brief Compute the gradient with central differences of one sample of the current level.
+\param p Point.
+*/
+Vector BrickedVolumeField::Gradient(const Vector& p) const
+{
+  if (!IsOpen())
+  {
+    return Vector::Null;
+  }
+  const Vector& d = levels[level].d;
+  return Vector(
+    (Value(p + Vector(d[0], 0.0, 0.0)) - Value(p - Vector(d[0], 0.0, 0.0))) / (2.0 * d[0]),
+    (Value(p + Vector(0.0, d[1], 0.0)) - Value(p - Vector(0.0, d[1], 0.0))) / (2.0 * d[1]),
+    (Value(p + Vector(0.0, 0.0, d[2])) - Value(p - Vector(0.0, 0.0, d[2]))) / (2.0 * d[2]));
+}
+
+/*!
+\brief Return a Lipschitz constant of the current level.
+
+The bound is derived from the ranges of the bricks, so that no brick is read. It is null if the volume is not open.
+*/
+double BrickedVolumeField::Lipschitz() const
+{
+  if (!IsOpen())
+  {
+    return 0.0;
+  }
+  const Level& l = levels[level];
+  double k = 0.0;
+  for (size_t i = 0; i < l.range.size(); i += 2)
+  {
+    k = Math::Max(k, l.range[i + 1] - l.range[i]);
+  }
+  return sqrt(3.0) * k / Math::Min(l.d[0], l.d[1], l.d[2]);
+}
+
+/*!
+\brief Set the level used for evaluating the field.
+\param l Level, 0 is the finest one.
+*/
+void BrickedVolumeField::SetLevel(int l)
+{
+  level = std::max(std::min(l, int(levels.size()) - 1), 0);
+}
+
+/*!
+\brief Return the coarsest level whose samples are not farther apart than a given size.
+\param size Distance between samples, such as the size of a pixel projected at the distance of the volume.
+*/
+int BrickedVolumeField::Select(double size) const
+{
+  int l = 0;
+  while (l + 1 < int(levels.size()) && Math::Max(levels[l + 1].d[0], levels[l + 1].d[1], levels[l + 1].d[2]) <= size)
+  {
+    l++;
+  }
+  return l;
+}
+
+/*!
+\brief Check whether a brick of the current level straddles the iso-value, false if the volume is not open.
+\param i,j,k Integer coordinates of the brick.
+*/
+bool BrickedVolumeField::Straddle(int i, int j, int k) const
+{
+  if (!IsOpen())
+  {
+    return false;
+  }
+  const Level& l = levels[level];
+  const int index = (k * l.by + j) * l.bx + i;
+  return l.range[2 * index] <= iso && iso <= l.range[2 * index + 1];
+}
+
+/*!
+\brief Set the iso-value.
+\param value Iso-value.
+*/
+void BrickedVolumeField::SetIso(double value)
+{
+  iso = value;
+}
+
+/*!
+\brief Return the iso-value.
+*/
+double BrickedVolumeField::GetIso() const
+{
+  return iso;
+}
+
+/*!
+\brief Field of the current level for the polygonization, evaluated exactly only in the cells that overlap a straddling brick.
+
+A cell of the grid of the polygonization that only overlaps bricks which do not straddle the iso-value cannot contain the surface,
+since adjacent bricks share their faces and therefore have the same sign. Points outside of the cells overlapping a straddling brick
+get the bound of the field over their brick that is the closest to zero, which has the sign of the field, and the brick is not read.
+Corners and edges of the cells with a sign change always get exact values, so the mesh is the same as with the exact field.
+*/
+struct BrickedVolumeField::Sparse
+{
+  const BrickedVolumeField& f; //!< Volume.
+  int s;                       //!< Stride of the grid of the polygonization, in samples.
+
+  //! Check whether a point touches a cell of the grid that overlaps a straddling brick.
+  bool Exact(const Vector& p) const
+  {
+    const Level& l = f.levels[f.level];
+    const int n[3] = { l.nx, l.ny, l.nz };
+    const int m[3] = { l.bx, l.by, l.bz };
+    int b0[3], b1[3];
+    for (int a = 0; a < 3; a++)
+    {
+      // Cells touching the point, with a tolerance for points on their faces, then the bricks overlapping those cells
+      const double t = (p[a] - f.box[0][a]) / (s * l.d[a]);
+      const int c0 = std::max(int(floor(t - 1.0e-6)), 0);
+      const int c1 = std::max(int(floor(t + 1.0e-6)), 0);
+      b0[a] = std::min(std::min(c0 * s, n[a] - 1) / f.brick, m[a] - 1);
+      b1[a] = std::min(std::min((c1 + 1) * s, n[a] - 1) / f.brick, m[a] - 1);
+    }
+    for (int k = b0[2]; k <= b1[2]; k++)
+    {
+      for (int j = b0[1]; j <= b1[1]; j++)
+      {
+        for (int i = b0[0]; i <= b1[0]; i++)
+        {
+          if (f.Straddle(i, j, k))
+          {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  //! Compute the value of the field at a set of points, exact points are evaluated with a single batch.
+  void Values(const double* x, const double* y, const double* z, double* v, int n) const
+  {
+    const Level& l = f.levels[f.level];
+    std::vector<double> ex, ey, ez, ev;
+    std::vector<int> e;
+    for (int h = 0; h < n; h++)
+    {
+      const Vector p(x[h], y[h], z[h]);
+      if (Exact(p))
+      {
+        ex.push_back(x[h]); ey.push_back(y[h]); ez.push_back(z[h]); e.push_back(h);
+        continue;
+      }
+      Vector u;
+      const int index = f.Locate(l, p, u);
+      const double lo = l.range[2 * index];
+      v[h] = (lo > f.iso) ? f.iso - lo : f.iso - l.range[2 * index + 1];
+    }
+    ev.resize(e.size());
+    f.Values(ex.data(), ey.data(), ez.data(), ev.data(), int(e.size()));
+    for (int h = 0; h < int(e.size()); h++)
+    {
+      v[e[h]] = ev[h];
+    }
+  }
+
+  //! Compute the value and the gradient, only queried on the straddling edges.
+  double ValueGradient(const Vector& p, Vector& g) const
+  {
+    return f.ValueGradient(p, g);
+  }
+
+  //! Compute the normal.
+  Vector Normal(const Vector& p) const
+  {
+    return f.Normal(p);
+  }
+};
+
+/*!
+\brief Compute the polygonal mesh approximating the iso-surface of the current level with grid nodes on the samples.
+
+Only the bricks overlapping the cells that straddle the iso-value are read, see BrickedVolumeField::Straddle().
+The mesh is empty if the volume is not open.
+\param g Returned geometry, with the storage it has on entry.
+\param s Stride, the grid uses one sample out of s along every axis.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void BrickedVolumeField::Polygonize(Mesh& g, int s, const double& epsilon) const
+{
+  if (!IsOpen())
+  {
+    g = Mesh(g.GetPrecision());
+    return;
+  }
+  const Level& l = levels[level];
+  s = std::max(s, 1);
+  const int mx = (l.nx - 1) / s + 1;
+  const int my = (l.ny - 1) / s + 1;
+  const int mz = (l.nz - 1) / s + 1;
+  const Box region(box[0], box[0] + Vector((mx - 1) * s * l.d[0], (my - 1) * s * l.d[1], (mz - 1) * s * l.d[2]));
+#ifdef TINYMESH_STATISTICS
+  Statistics stats;
+  AnalyticScalarField::Polygonize(Sparse{ *this, s }, mx, my, mz, g, region, epsilon, finder, iterations, &evaluations, &stats);
+  statistics = stats;
+#else
+  AnalyticScalarField::Polygonize(Sparse{ *this, s }, mx, my, mz, g, region, epsilon, finder, iterations, &evaluations);
+#endif
+}
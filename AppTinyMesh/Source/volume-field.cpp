@@ -0,0 +1,308 @@
+// Volume scalar field
+
+// Self include
+#include "volume-field.h"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*!
+\class VolumeScalarField volume-field.h
+\brief A field function defined by a raw voxel volume, such as scanned or simulated data.
+
+The file is memory mapped rather than read, so that volumes of several gigabytes can be polygonized
+without being copied into memory: the operating system pages in the voxels that are accessed.
+Voxels are stored without any header other than an optional offset, x varying the fastest, then y and z.
+
+The field is the trilinear interpolation of the voxels, offset by an iso-value, and is negative inside, where values are greater
+than the iso-value:
+
+\code
+VolumeScalarField ct("head.raw", 512, 512, 256, VolumeScalarField::UInt16, Box(Vector(0.0), Vector(25.6, 25.6, 12.8)), 1200.0);
+Mesh mesh;
+ct.Polygonize(mesh, 2);
+\endcode
+
+Grid nodes that land exactly on voxel centers are evaluated by a direct lookup without interpolation, which is the case of
+VolumeScalarField::Polygonize(Mesh&, int, const double&) const and of polygonizations whose grid is aligned with the voxels.
+*/
+
+/*!
+\brief Map a raw volume.
+
+If the file cannot be mapped or is too short, the volume is not open, see VolumeScalarField::IsOpen().
+\param filename File name.
+\param x,y,z Number of voxels along each axis.
+\param type Type of the voxels.
+\param box Region covered by the volume.
+\param value Iso-value.
+\param offset Size of the header of the file in bytes, skipped.
+*/
+VolumeScalarField::VolumeScalarField(const std::string& filename, int x, int y, int z, Format type, const Box& box, double value, size_t offset)
+  :box(box), nx(x), ny(y), nz(z), format(type), iso(value), data(nullptr), mapping(nullptr), length(0), k(-1.0)
+{
+  Vector diagonal = box.Diagonal();
+  d = Vector(diagonal[0] / (nx - 1), diagonal[1] / (ny - 1), diagonal[2] / (nz - 1));
+
+  const size_t bytes = (format == UInt8) ? 1 : (format == UInt16 ? 2 : 4);
+  const size_t size = offset + size_t(nx) * ny * nz * bytes;
+
+#ifdef _WIN32
+  file = nullptr;
+  view = nullptr;
+  HANDLE h = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+  LARGE_INTEGER s;
+  if (!GetFileSizeEx(h, &s) || size_t(s.QuadPart) < size)
+  {
+    CloseHandle(h);
+    return;
+  }
+  HANDLE m = CreateFileMappingA(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m == nullptr)
+  {
+    CloseHandle(h);
+    return;
+  }
+  const void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, size);
+  if (p == nullptr)
+  {
+    CloseHandle(m);
+    CloseHandle(h);
+    return;
+  }
+  file = h;
+  view = m;
+#else
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return;
+  }
+  struct stat s;
+  if (fstat(fd, &s) != 0 || size_t(s.st_size) < size)
+  {
+    close(fd);
+    return;
+  }
+  void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+  {
+    return;
+  }
+#endif
+
+  mapping = static_cast<const unsigned char*>(p);
+  length = size;
+  data = mapping + offset;
+}
+
+/*!
+\brief Unmap the volume.
+*/
+VolumeScalarField::~VolumeScalarField()
+{
+  if (mapping == nullptr)
+  {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(mapping);
+  CloseHandle(view);
+  CloseHandle(file);
+#else
+  munmap(const_cast<unsigned char*>(mapping), length);
+#endif
+}
+
+/*!
+\brief Check whether the volume has been mapped.
+*/
+bool VolumeScalarField::IsOpen() const
+{
+  return data != nullptr;
+}
+
+/*!
+\brief Set the iso-value.
+\param value Iso-value.
+*/
+void VolumeScalarField::SetIso(double value)
+{
+  iso = value;
+}
+
+/*!
+\brief Return the iso-value.
+*/
+double VolumeScalarField::GetIso() const
+{
+  return iso;
+}
+
+/*!
+\brief Compute the trilinear interpolation of the voxels.
+
+Points outside of the volume are projected onto its box.
+\param p Point.
+*/
+double VolumeScalarField::Trilinear(const Vector& p) const
+{
+  double u[3];
+  int c[3];
+  const int s[3] = { nx, ny, nz };
+  for (int a = 0; a < 3; a++)
+  {
+    const double t = Math::Clamp((p[a] - box[0][a]) / d[a], 0.0, double(s[a] - 1));
+    c[a] = std::min(int(t), s[a] - 2);
+    u[a] = t - c[a];
+  }
+
+  const int i = c[0], j = c[1], l = c[2];
+  const double x00 = (1.0 - u[0]) * Voxel(i, j, l) + u[0] * Voxel(i + 1, j, l);
+  const double x10 = (1.0 - u[0]) * Voxel(i, j + 1, l) + u[0] * Voxel(i + 1, j + 1, l);
+  const double x01 = (1.0 - u[0]) * Voxel(i, j, l + 1) + u[0] * Voxel(i + 1, j, l + 1);
+  const double x11 = (1.0 - u[0]) * Voxel(i, j + 1, l + 1) + u[0] * Voxel(i + 1, j + 1, l + 1);
+  const double y0 = (1.0 - u[1]) * x00 + u[1] * x10;
+  const double y1 = (1.0 - u[1]) * x01 + u[1] * x11;
+  return (1.0 - u[2]) * y0 + u[2] * y1;
+}
+
+/*!
+\brief Compute the value of the field, negative where the volume is greater than the iso-value.
+
+A volume that is not open is empty, and its field is infinite.
+\param p Point.
+*/
+double VolumeScalarField::Value(const Vector& p) const
+{
+  if (!IsOpen())
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  return iso - Trilinear(p);
+}
+
+/*!
+\brief Compute the value of the field at a set of points.
+
+Points that land on voxel centers, up to a small fraction of a voxel, are evaluated with a direct lookup.
+\param x,y,z Coordinates of the points.
+\param v Returned values.
+\param n Number of points.
+*/
+void VolumeScalarField::Values(const double* x, const double* y, const double* z, double* v, int n) const
+{
+  if (!IsOpen())
+  {
+    std::fill(v, v + n, std::numeric_limits<double>::infinity());
+    return;
+  }
+  for (int h = 0; h < n; h++)
+  {
+    const double tx = (x[h] - box[0][0]) / d[0];
+    const double ty = (y[h] - box[0][1]) / d[1];
+    const double tz = (z[h] - box[0][2]) / d[2];
+    const int i = int(floor(tx + 0.5));
+    const int j = int(floor(ty + 0.5));
+    const int l = int(floor(tz + 0.5));
+    if (fabs(tx - i) < 1e-6 && fabs(ty - j) < 1e-6 && fabs(tz - l) < 1e-6 && i >= 0 && i < nx && j >= 0 && j < ny && l >= 0 && l < nz)
+    {
+      v[h] = iso - Voxel(i, j, l);
+    }
+    else
+    {
+      v[h] = iso - Trilinear(Vector(x[h], y[h], z[h]));
+    }
+  }
+}
+
+/*!
+\brief Compute the gradient with central differences of one voxel.
+\param p Point.
+*/
+Vector VolumeScalarField::Gradient(const Vector& p) const
+{
+  if (!IsOpen())
+  {
+    return Vector::Null;
+  }
+  return Vector(
+    (Value(p + Vector(d[0], 0.0, 0.0)) - Value(p - Vector(d[0], 0.0, 0.0))) / (2.0 * d[0]),
+    (Value(p + Vector(0.0, d[1], 0.0)) - Value(p - Vector(0.0, d[1], 0.0))) / (2.0 * d[1]),
+    (Value(p + Vector(0.0, 0.0, d[2])) - Value(p - Vector(0.0, 0.0, d[2]))) / (2.0 * d[2]));
+}
+
+/*!
+\brief Return the Lipschitz constant of the trilinear interpolation.
+
+The constant is computed from the largest difference between adjacent voxels along every axis the first time it is needed,
+which reads the whole volume once. It is null if the volume is not open.
+*/
+double VolumeScalarField::Lipschitz() const
+{
+  if (!IsOpen())
+  {
+    return 0.0;
+  }
+  if (k < 0.0)
+  {
+    double gx = 0.0, gy = 0.0, gz = 0.0;
+    for (int c = 0; c < nz; c++)
+    {
+      for (int j = 0; j < ny; j++)
+      {
+        for (int i = 0; i < nx; i++)
+        {
+          const double v = Voxel(i, j, c);
+          if (i + 1 < nx) gx = Math::Max(gx, fabs(Voxel(i + 1, j, c) - v));
+          if (j + 1 < ny) gy = Math::Max(gy, fabs(Voxel(i, j + 1, c) - v));
+          if (c + 1 < nz) gz = Math::Max(gz, fabs(Voxel(i, j, c + 1) - v));
+        }
+      }
+    }
+    gx /= d[0];
+    gy /= d[1];
+    gz /= d[2];
+    k = sqrt(gx * gx + gy * gy + gz * gz);
+  }
+  return k;
+}
+
+/*!
+\brief Compute the polygonal mesh approximating the iso-surface with grid nodes on the voxels.
+
+Every grid node lands on a voxel, so that the classification of the grid uses the fast path without interpolation.
+The mesh is empty if the volume is not open.
+\param g Returned geometry, with the storage it has on entry.
+\param s Stride, the grid uses one voxel out of s along every axis.
+\param epsilon Epsilon value for computing vertices on straddling edges.
+*/
+void VolumeScalarField::Polygonize(Mesh& g, int s, const double& epsilon) const
+{
+  if (!IsOpen())
+  {
+    g = Mesh(g.GetPrecision());
+    return;
+  }
+  s = std::max(s, 1);
+  const int mx = (nx - 1) / s + 1;
+  const int my = (ny - 1) / s + 1;
+  const int mz = (nz - 1) / s + 1;
+  const Box region(box[0], Vertex((mx - 1) * s, (my - 1) * s, (mz - 1) * s));
+  AnalyticScalarField::Polygonize(mx, my, mz, g, region, epsilon);
+}
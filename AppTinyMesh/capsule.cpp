@@ -21,5 +21,5 @@ double Capsule::getHeight() const {
 \brief Returns Radius.
 */
 double Capsule::getRadius() const {
-	return height;
+	return radius;
 }
\ No newline at end of file
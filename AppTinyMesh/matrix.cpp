@@ -7,9 +7,9 @@
 param radius Radius
 */
 Matrix::Matrix() {
-	tab = new double* [2];
+	tab = new double* [3];
 	for (int i = 0; i <= 2; ++i) {
-		tab[i] = new double[2];
+		tab[i] = new double[3];
 		for (int j = 0; j <= 2; ++j) {
 			tab[i][j] = 0;
 		}
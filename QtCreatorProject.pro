@@ -4,6 +4,9 @@ greaterThan(QT_MAJOR_VERSION, 5): QT += openglwidgets
 
 CONFIG += c++11
 
+# Polygonization instrumentation, compiled out by default
+# DEFINES += TINYMESH_STATISTICS
+
 INCLUDEPATH += AppTinyMesh/Include
 INCLUDEPATH += $$(GLEW_DIR)
 INCLUDEPATH += $$(OUT_PWD)
@@ -14,6 +17,18 @@ SOURCES += \
     AppTinyMesh/Source/box.cpp \
     AppTinyMesh/Source/evector.cpp \
     AppTinyMesh/Source/implicits.cpp \
+    AppTinyMesh/Source/implicit-tree.cpp \
+    AppTinyMesh/Source/scalar-grid.cpp \
+    AppTinyMesh/Source/implicit-incremental.cpp \
+    AppTinyMesh/Source/mesh-distance.cpp \
+    AppTinyMesh/Source/volume-field.cpp \
+    AppTinyMesh/Source/volume-bricks.cpp \
+    AppTinyMesh/Source/blob-field.cpp \
+    AppTinyMesh/Source/primitive-fields.cpp \
+    AppTinyMesh/Source/mesh-bvh.cpp \
+    AppTinyMesh/Source/ray-packet.cpp \
+    AppTinyMesh/Source/vertex-array.cpp \
+    AppTinyMesh/Source/mesh-topology.cpp \
     AppTinyMesh/Source/main.cpp \
     AppTinyMesh/Source/camera.cpp \
     AppTinyMesh/Source/mesh.cpp \
@@ -29,6 +44,19 @@ HEADERS += \
     AppTinyMesh/Include/camera.h \
     AppTinyMesh/Include/color.h \
     AppTinyMesh/Include/implicits.h \
+    AppTinyMesh/Include/implicit-tree.h \
+    AppTinyMesh/Include/implicit-static.h \
+    AppTinyMesh/Include/scalar-grid.h \
+    AppTinyMesh/Include/implicit-incremental.h \
+    AppTinyMesh/Include/mesh-distance.h \
+    AppTinyMesh/Include/volume-field.h \
+    AppTinyMesh/Include/volume-bricks.h \
+    AppTinyMesh/Include/blob-field.h \
+    AppTinyMesh/Include/primitive-fields.h \
+    AppTinyMesh/Include/mesh-bvh.h \
+    AppTinyMesh/Include/ray-packet.h \
+    AppTinyMesh/Include/vertex-array.h \
+    AppTinyMesh/Include/mesh-topology.h \
     AppTinyMesh/Include/mathematics.h \
     AppTinyMesh/Include/mesh.h \
     AppTinyMesh/Include/meshcolor.h \
@@ -39,6 +67,15 @@ HEADERS += \
 FORMS += \
     AppTinyMesh/UI/interface.ui
 
+# OpenMP (parallel polygonization)
+msvc {
+    QMAKE_CXXFLAGS += /openmp
+}
+unix:!macx {
+    QMAKE_CXXFLAGS += -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
+
 win32 {
     LIBS += -L$$(GLEW_DIR) -lglew32
     LIBS += -lopengl32 -lglu32